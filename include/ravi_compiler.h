@@ -23,11 +23,49 @@ struct linearizer_state;
 typedef long long lua_Integer;
 typedef double lua_Number;
 
+/*
+ * Memory allocation hooks, each is passed user_data as its first argument. realloc and free are
+ * only given memory returned by the same hooks. A hook that cannot satisfy a request returns NULL;
+ * the api call that was running - raviX_parse(), raviX_lex_all(), raviX_ast_typecheck(),
+ * raviX_ast_linearize() and the like - then fails and raviX_get_last_error() returns "out of memory".
+ * Outside those calls a failed allocation aborts. The parallel lexer calls the hooks from several
+ * threads at once.
+ */
+struct memory_allocator {
+	void *(*alloc)(void *user_data, size_t size);
+	void *(*realloc)(void *user_data, void *ptr, size_t size);
+	void (*free)(void *user_data, void *ptr);
+	void *user_data;
+};
+
 /* Initialize the compiler state */
 /* During compilation all data structures are stored in the compiler state */
 RAVICOMP_EXPORT struct compiler_state *raviX_init_compiler(void);
-/* Destroy the compiler state */
+/*
+ * Same as raviX_init_compiler() but all memory owned by the compiler state, including the state
+ * itself, comes from the given hooks, which are copied. Returns NULL if the state cannot be allocated.
+ */
+RAVICOMP_EXPORT struct compiler_state *raviX_init_compiler_with_allocator(const struct memory_allocator *allocator);
+/* Destroy the compiler state and free it */
 RAVICOMP_EXPORT void raviX_destroy_compiler(struct compiler_state *compiler);
+/*
+ * Drops everything the compiler state holds - syntax tree, strings, linearizer, last error - and
+ * restores the default settings, but keeps the memory its allocators and string set have grown to,
+ * so that the next chunk compiled with it makes almost no calls to malloc.
+ */
+RAVICOMP_EXPORT void raviX_reset_compiler(struct compiler_state *compiler);
+
+/*
+ * A pool of compiler states for services that compile many chunks. raviX_compiler_pool_acquire()
+ * returns a reset state from the pool, or a new one if the pool is empty. raviX_compiler_pool_release()
+ * resets the state and keeps it for reuse, unless the pool already holds max_free states, in which
+ * case the state is destroyed. The pool may be used from several threads at once.
+ */
+struct compiler_pool;
+RAVICOMP_EXPORT struct compiler_pool *raviX_create_compiler_pool(unsigned max_free);
+RAVICOMP_EXPORT void raviX_destroy_compiler_pool(struct compiler_pool *pool);
+RAVICOMP_EXPORT struct compiler_state *raviX_compiler_pool_acquire(struct compiler_pool *pool);
+RAVICOMP_EXPORT void raviX_compiler_pool_release(struct compiler_pool *pool, struct compiler_state *compiler);
 
 /* ------------------------ LEXICAL ANALYZER API -------------------------------*/
 /* This is derived from PuC Lua implementation                              */
@@ -89,13 +127,15 @@ enum TokenType {
  * need a string type that has a length associated with it.
  *
  * The compiler stores a single copy of each string so that strings
- * can be compared by equality.
+ * can be compared by equality. The characters of a copied string are
+ * stored right after the string_object in the same allocation, so
+ * str points just past the header.
  */
 struct string_object {
 	uint32_t len;	  /* length of the string */
 	int32_t reserved; /* if is this a keyword then token id else -1 */
 	uint32_t hash;	  /* hash value of the string */
-	const char *str;  /* string data */
+	const char *str;  /* string data, 0 terminated unless zero copy strings are enabled */
 };
 
 /*
@@ -109,6 +149,7 @@ typedef union {
 
 typedef struct Token {
 	int token; /* Token value or character value; token values start from FIRST_RESERVED which is 257 */
+	uint32_t offset; /* Byte offset of the start of the token in the source */
 	SemInfo seminfo; /* Literal associated with the token, only valid when token is a literal or an identifier, i.e. token is > TOK_EOS */
 } Token;
 
@@ -119,6 +160,7 @@ typedef struct {
 	int current;	 /* current character (char as int) */
 	int linenumber;	 /* input line counter */
 	int lastline;	 /* line of last token 'consumed' */
+	uint32_t lastoffset; /* offset of last token 'consumed' */
 	Token t;	 /* current token, set after call to raviX_next() */
 	Token lookahead; /* look ahead token, set after call to raviX_lookahead() */
 } LexState;
@@ -130,10 +172,16 @@ typedef struct {
  * The reason for exposing this is that we use it for getting the token string in one of the
  * api calls.
  */
+struct memory_context;
+/* Receives output a piece at a time; the bytes are not 0 terminated */
+typedef void (*raviX_Writer)(void *data, const char *bytes, size_t size);
 typedef struct {
 	char *buf;
 	size_t allocated_size;
 	size_t pos;
+	struct memory_context *memory; /* where buf comes from, NULL for malloc */
+	raviX_Writer writer;	       /* if set, the content is handed to the writer whenever the buffer is full */
+	void *writer_data;
 } membuff_t;
 
 /* all strings are interned and stored in a hash set, strings may have embedded
@@ -142,6 +190,17 @@ typedef struct {
 RAVICOMP_EXPORT const struct string_object *raviX_create_string(struct compiler_state *container, const char *s,
 								uint32_t len);
 
+/*
+ * A string interner that can be shared by many compiler states, including ones used on different threads.
+ * Each distinct string is then stored once, and string objects are equal by address across the compiler
+ * states too. The interner must be set before the compiler state creates any strings, and must outlive
+ * all compiler states that use it. Strings are always copied into the interner, zero copy strings do not apply.
+ */
+struct string_interner;
+RAVICOMP_EXPORT struct string_interner *raviX_create_string_interner(void);
+RAVICOMP_EXPORT void raviX_destroy_string_interner(struct string_interner *interner);
+RAVICOMP_EXPORT void raviX_set_string_interner(struct compiler_state *compiler_state, struct string_interner *interner);
+
 /* Initialize lexical analyser. Takes as input a buffer containing Lua/Ravi source and the source name */
 RAVICOMP_EXPORT struct lexer_state *raviX_init_lexer(struct compiler_state *compiler_state, const char *buf,
 						     size_t buflen, const char *source_name);
@@ -149,6 +208,16 @@ RAVICOMP_EXPORT struct lexer_state *raviX_init_lexer(struct compiler_state *comp
  * a readonly data structure
  */
 RAVICOMP_EXPORT const LexState *raviX_get_lexer_info(struct lexer_state *ls);
+/*
+ * Reader function for streaming input, similar to lua_Reader. Each call must return the next block
+ * of input and set *size to the size of the block. Returning NULL or setting *size to 0 signals end
+ * of input. A block must remain valid until the next call.
+ */
+typedef const char *(*raviX_Reader)(void *data, size_t *size);
+/* Initializes a lexer that reads its input from the given reader rather than a buffer. */
+RAVICOMP_EXPORT struct lexer_state *raviX_init_lexer_with_reader(struct compiler_state *compiler_state,
+								 raviX_Reader reader, void *reader_data,
+								 const char *source_name);
 /* Retrieves the next token and saves it is LexState structure. If a lookahead was set then that is retrieved
  * (and reset to EOS) else the next token is retrieved
  */
@@ -162,6 +231,66 @@ RAVICOMP_EXPORT void raviX_token2str(int token, membuff_t *mb);
 /* Release all data structures used by the lexer */
 RAVICOMP_EXPORT void raviX_destroy_lexer(struct lexer_state *);
 
+/*
+ * Batch tokenization. The whole input is tokenized in one call and the result is stored as
+ * a structure of arrays - entry i of each array describes token i. The last token
+ * is always TOK_EOS. Strings referenced by seminfo are owned by the compiler state, hence
+ * the token stream is only valid as long as the compiler state is alive.
+ *
+ * Everything below should be treated as readonly
+ */
+typedef struct {
+	uint32_t count;	    /* number of tokens, including the final TOK_EOS */
+	uint32_t capacity;  /* allocated size of each array */
+	uint16_t *token;    /* Token value or character value, as in Token.token */
+	uint32_t *offset;   /* byte offset of the first character of the token in source */
+	uint32_t *length;   /* length of the token text in bytes */
+	int *line;	    /* line number on which the token starts */
+	SemInfo *seminfo;   /* literal associated with the token, only valid when token is > TOK_EOS or '@' */
+	const char *source; /* the buffer that was tokenized */
+	struct memory_allocator allocator; /* hooks of the compiler state that allocated the arrays */
+} TokenStream;
+
+/*
+ * Zero copy strings, disabled by default. When enabled the caller guarantees that the source buffers
+ * passed to raviX_parse() and raviX_lex_all() outlive the compiler state. Names and literals that
+ * appear verbatim in the source are then not copied - their string objects point into the source buffer.
+ * Only literals that had escapes or line breaks converted get copied. Note that in this mode
+ * string_object.str is not 0 terminated, string_object.len must be used.
+ */
+RAVICOMP_EXPORT void raviX_set_zero_copy_strings(struct compiler_state *compiler_state, bool enable);
+
+/* Tokenizes the input buffer into the supplied stream. The stream must be zero initialized before first use,
+ * it can then be reused for subsequent calls, in which case the arrays are reused.
+ * Returns 0 on success, non-zero on failure, the error message is available via raviX_get_last_error().
+ */
+RAVICOMP_EXPORT int raviX_lex_all(struct compiler_state *compiler_state, const char *buf, size_t buflen,
+				  const char *source_name, TokenStream *stream);
+/* Same as raviX_lex_all() but for large inputs: the input is split into slices of about 'slice_size'
+ * bytes that are tokenized in parallel by up to 'threads' threads. A slice may start inside a string
+ * or comment, in which case the main thread re-lexes it, so the result is always the same as that of
+ * raviX_lex_all(). If 'threads' is 0 the number of hardware threads is used, and if 'slice_size' is 0
+ * the input is split evenly between the threads, unless that makes the slices too small to be worth it.
+ * Returns 0 on success, non-zero on failure, the error message is available via raviX_get_last_error().
+ */
+RAVICOMP_EXPORT int raviX_lex_all_parallel(struct compiler_state *compiler_state, const char *buf, size_t buflen,
+					   const char *source_name, TokenStream *stream, unsigned threads,
+					   size_t slice_size);
+/* Updates a token stream after an edit, re-lexing only the part of the input affected by it.
+ * 'buf' is the edited input: the old input with the 'removed' bytes at 'edit_offset' replaced by
+ * 'inserted' bytes, which are therefore at the same offset in 'buf'. Lexing restarts at the last token
+ * before the edit and stops as soon as a new token lines up with an old one after the edit; the
+ * remaining old tokens are then moved to their new offsets and lines. The stream must have been created
+ * by raviX_lex_all() using the same compiler state, without zero copy strings unless the old input
+ * outlives the compiler state. On failure the stream is left unchanged.
+ * Returns 0 on success, non-zero on failure, the error message is available via raviX_get_last_error().
+ */
+RAVICOMP_EXPORT int raviX_relex(struct compiler_state *compiler_state, TokenStream *stream, const char *buf,
+				size_t buflen, size_t edit_offset, size_t removed, size_t inserted,
+				const char *source_name);
+/* Releases the arrays held by the token stream */
+RAVICOMP_EXPORT void raviX_destroy_token_stream(TokenStream *stream);
+
 /* ---------------- PARSER API -------------------------- */
 
 /*
@@ -178,8 +307,27 @@ RAVICOMP_EXPORT void raviX_destroy_lexer(struct lexer_state *);
  * Returns 0 on success, non-zero on failure.
  */
 RAVICOMP_EXPORT int raviX_parse(struct compiler_state *compiler_state, const char *buffer, size_t buflen, const char *name);
-/* Prints out the AST to the file */
-RAVICOMP_EXPORT void raviX_output_ast(struct compiler_state *compiler_state, FILE *fp);
+/*
+ * Same as raviX_parse() but the input is obtained from a reader in blocks, so the
+ * whole chunk need not be in memory. Zero copy strings are not used with a reader.
+ *
+ * Returns 0 on success, non-zero on failure.
+ */
+RAVICOMP_EXPORT int raviX_parse_with_reader(struct compiler_state *compiler_state, raviX_Reader reader,
+					    void *reader_data, const char *name);
+/*
+ * Same as raviX_parse() but consumes tokens from a stream previously created by raviX_lex_all(),
+ * using the same compiler state.
+ *
+ * Returns 0 on success, non-zero on failure.
+ */
+RAVICOMP_EXPORT int raviX_parse_token_stream(struct compiler_state *compiler_state, const TokenStream *stream,
+					     const char *name);
+/* Prints out the AST to the file; returns non-zero if out of memory */
+RAVICOMP_EXPORT int raviX_output_ast(struct compiler_state *compiler_state, FILE *fp);
+/* Prints out the AST, handing it to the writer in pieces of a few KB as it goes; returns non-zero
+ * if out of memory, in which case part of the AST may have been written */
+RAVICOMP_EXPORT int raviX_write_ast(struct compiler_state *compiler_state, raviX_Writer writer, void *writer_data);
 /* Performs type checks on the AST and annotates types of expressions nad variables where possible.
  * As a result the AST will be modified.
  *
@@ -193,17 +341,89 @@ raviX_ast_typecheck(struct compiler_state *compiler_state); /* Perform type chec
  * The goal of this component is to convert the AST to a linear IR.
  * This is work in progress, therefore the IR is not yet publicly exposed.
  */
+/* Returns NULL if out of memory */
 RAVICOMP_EXPORT struct linearizer_state *raviX_init_linearizer(struct compiler_state *compiler_state);
 /* Attempts to create linear IR for given AST.
  * Returns 0 on success.
  */
 RAVICOMP_EXPORT int raviX_ast_linearize(struct linearizer_state *linearizer);
-/* Prints out the content of the linear IR */
-RAVICOMP_EXPORT void raviX_output_linearizer(struct linearizer_state *linearizer, FILE *fp);
+/*
+ * Lets go of the syntax tree once it has been linearized: what the linear IR still uses is copied
+ * into the linearizer, and the syntax tree, symbols and scopes of the compiler state are freed.
+ * Strings stay with the compiler state. Afterwards the compiler state has no syntax tree to
+ * print, typecheck or linearize again. Returns 0 on success; if it runs out of memory the syntax
+ * tree is kept.
+ */
+RAVICOMP_EXPORT int raviX_linearizer_release_ast(struct linearizer_state *linearizer);
+/* Prints out the content of the linear IR; returns non-zero if out of memory */
+RAVICOMP_EXPORT int raviX_output_linearizer(struct linearizer_state *linearizer, FILE *fp);
+/* Prints out the content of the linear IR, handing it to the writer in pieces of a few KB as it goes;
+ * returns non-zero if out of memory, in which case part of the IR may have been written */
+RAVICOMP_EXPORT int raviX_write_linearizer(struct linearizer_state *linearizer, raviX_Writer writer,
+					   void *writer_data);
 RAVICOMP_EXPORT void raviX_destroy_linearizer(struct linearizer_state *linearizer);
 
 /* utilies */
 RAVICOMP_EXPORT const char *raviX_get_last_error(struct compiler_state *compiler_state);
+/*
+ * Maps a byte offset in the source last lexed or parsed by the compiler state, such as
+ * Token.offset or the offset of an AST node, to a line and column. Both are 1 based and the
+ * column counts bytes. The lexer records where each line starts as it goes, so this is a
+ * binary search and does not look at the source again.
+ */
+RAVICOMP_EXPORT void raviX_get_line_and_column(const struct compiler_state *compiler_state, uint32_t offset,
+					       int *line, int *column);
+
+/* ----------------------- STATISTICS ------------------------ */
+
+/* raviX_parse() and friends pull tokens as they go, so their time includes lexing */
+enum compiler_phase {
+	COMPILER_PHASE_LEX, /* raviX_lex_all(), raviX_lex_all_parallel() and raviX_relex() */
+	COMPILER_PHASE_PARSE,
+	COMPILER_PHASE_TYPECHECK,
+	COMPILER_PHASE_LINEARIZE,
+	COMPILER_PHASE_COUNT
+};
+
+struct compiler_phase_stats {
+	uint32_t calls;
+	uint64_t nanoseconds; /* wall time, summed over the calls */
+	uint64_t bytes;	      /* bytes requested from the memory hooks, including reallocations */
+};
+
+struct compiler_allocator_stats {
+	const char *name;
+	size_t total_bytes; /* memory held by the allocator, including chunks kept for reuse */
+	size_t used_bytes;  /* memory handed out as objects */
+	size_t objects;	    /* live objects, for allocators of objects of one size; 0 otherwise */
+};
+
+enum { COMPILER_STATS_MAX_ALLOCATORS = 16 };
+
+/*
+ * Cost of the work done with a compiler state since it was created or last reset. The
+ * linearizer's allocators and objects are those of the last raviX_ast_linearize() call, and
+ * remain available after the linearizer is destroyed. Strings interned in a shared string
+ * interner are not counted.
+ */
+struct compiler_stats {
+	struct compiler_phase_stats phases[COMPILER_PHASE_COUNT];
+	unsigned allocator_count;
+	struct compiler_allocator_stats allocators[COMPILER_STATS_MAX_ALLOCATORS];
+	size_t ast_nodes;
+	size_t symbols;
+	size_t ptrlist_nodes; /* of the compiler state and the linearizer */
+	size_t pseudos;
+	size_t instructions;
+	size_t basic_blocks;
+	size_t strings;
+	size_t string_bytes;	  /* interned strings, headers included */
+	size_t peak_string_bytes; /* most seen at the end of any phase */
+};
+
+/* Fills in stats; cheap enough to call after every chunk */
+RAVICOMP_EXPORT void raviX_get_compiler_stats(const struct compiler_state *compiler_state,
+					      struct compiler_stats *stats);
 
 /* ----------------------- AST WALKING API ------------------------ */
 
@@ -493,6 +713,8 @@ raviX_function_call_expression_foreach_argument(const struct function_call_expre
 
 /* Convert a statement to the correct type */
 RAVICOMP_EXPORT enum ast_node_type raviX_statement_type(const struct statement *statement);
+/* Byte offset in the source, of the last token consumed when the statement was created */
+RAVICOMP_EXPORT uint32_t raviX_statement_offset(const struct statement *statement);
 RAVICOMP_EXPORT const struct return_statement *raviX_return_statement(const struct statement *stmt);
 RAVICOMP_EXPORT const struct label_statement *raviX_label_statement(const struct statement *stmt);
 RAVICOMP_EXPORT const struct goto_statement *raviX_goto_statement(const struct statement *stmt);
@@ -507,6 +729,8 @@ RAVICOMP_EXPORT const struct for_statement *raviX_for_statement(const struct sta
 
 /* Convert an expression to the correct type */
 RAVICOMP_EXPORT enum ast_node_type raviX_expression_type(const struct expression *expression);
+/* Byte offset in the source, of the last token consumed when the expression was created */
+RAVICOMP_EXPORT uint32_t raviX_expression_offset(const struct expression *expression);
 RAVICOMP_EXPORT const struct literal_expression *raviX_literal_expression(const struct expression *expr);
 RAVICOMP_EXPORT const struct symbol_expression *raviX_symbol_expression(const struct expression *expr);
 RAVICOMP_EXPORT const struct index_expression *raviX_index_expression(const struct expression *expr);
@@ -559,6 +783,12 @@ RAVICOMP_EXPORT void raviX_buffer_init(membuff_t *mb, size_t initial_size);
 RAVICOMP_EXPORT void raviX_buffer_resize(membuff_t *mb, size_t new_size);
 RAVICOMP_EXPORT void raviX_buffer_reserve(membuff_t *mb, size_t n);
 RAVICOMP_EXPORT void raviX_buffer_free(membuff_t *mb);
+/* The buffer holds at most chunk_size bytes; when it is full they are handed to the writer and
+ * the buffer is emptied. raviX_buffer_flush() hands over whatever is left. The buffer is allocated
+ * from memory, or with malloc if memory is NULL. */
+RAVICOMP_EXPORT void raviX_buffer_init_with_writer(membuff_t *mb, size_t chunk_size, struct memory_context *memory,
+						   raviX_Writer writer, void *writer_data);
+RAVICOMP_EXPORT void raviX_buffer_flush(membuff_t *mb);
 static inline char *raviX_buffer_data(membuff_t *mb) { return mb->buf; }
 static inline size_t raviX_buffer_size(membuff_t *mb) { return mb->allocated_size; }
 static inline size_t raviX_buffer_len(membuff_t *mb) { return mb->pos; }
@@ -567,6 +797,12 @@ static inline void raviX_buffer_reset(membuff_t *mb) { mb->pos = 0; }
 /* following convert input to string before adding */
 RAVICOMP_EXPORT void raviX_buffer_add_string(membuff_t *mb, const char *str);
 RAVICOMP_EXPORT void raviX_buffer_add_fstring(membuff_t *mb, const char *str, ...) FORMAT_ATTR(2);
+/* following do not go through printf */
+RAVICOMP_EXPORT void raviX_buffer_add_bytes(membuff_t *mb, const char *str, size_t len);
+RAVICOMP_EXPORT void raviX_buffer_add_int(membuff_t *mb, int value);
+RAVICOMP_EXPORT void raviX_buffer_add_longlong(membuff_t *mb, int64_t value);
+/* Same as "%.*f", with digits decimal places */
+RAVICOMP_EXPORT void raviX_buffer_add_double(membuff_t *mb, double value, int digits);
 
 /* strncpy() replacement with guaranteed 0 termination */
 RAVICOMP_EXPORT void raviX_string_copy(char *buf, const char *src, size_t buflen);
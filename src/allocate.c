@@ -42,23 +42,114 @@
 #include <stdlib.h>
 #include <string.h>
 
-static void *blob_alloc(size_t size) {
-  void *ptr;
-  ptr = malloc(size);
-  if (ptr != NULL)
-    memset(ptr, 0, size);
+static void *default_alloc(void *user_data, size_t size) {
+  (void)user_data;
+  return malloc(size);
+}
+static void *default_realloc(void *user_data, void *ptr, size_t size) {
+  (void)user_data;
+  return realloc(ptr, size);
+}
+static void default_free(void *user_data, void *ptr) {
+  (void)user_data;
+  free(ptr);
+}
+
+struct memory_context raviX_default_memory = {
+    {default_alloc, default_realloc, default_free, NULL}, NULL, false, 0};
+
+void raviX_memory_init(struct memory_context *memory,
+                       const struct memory_allocator *hooks) {
+  memory->hooks = hooks ? *hooks : raviX_default_memory.hooks;
+  memory->env = NULL;
+  memory->failed = false;
+  memory->bytes_requested = 0;
+}
+
+/*
+* Callers without a context of their own - the shared interner among
+* them, from several threads - use the global one, which is not counted.
+*/
+static inline struct memory_context *
+counted_request(struct memory_context *memory, size_t size) {
+  if (!memory)
+    return &raviX_default_memory;
+  memory->bytes_requested += size;
+  return memory;
+}
+
+void raviX_out_of_memory(struct memory_context *memory) {
+  if (memory->env) {
+    memory->failed = true;
+    longjmp(*memory->env, 1);
+  }
+  fprintf(stderr, "out of memory\n");
+  abort();
+}
+
+void *raviX_try_calloc(struct memory_context *memory, size_t count,
+                       size_t size) {
+  if (size != 0 && count > (size_t)-1 / size)
+    return NULL;
+  memory = counted_request(memory, count * size);
+  void *ptr = memory->hooks.alloc(memory->hooks.user_data, count * size);
+  if (ptr)
+    memset(ptr, 0, count * size);
   return ptr;
 }
 
-static void blob_free(void *addr, size_t size) {
+void *raviX_try_realloc(struct memory_context *memory, void *ptr, size_t size) {
+  memory = counted_request(memory, size);
+  return memory->hooks.realloc(memory->hooks.user_data, ptr, size);
+}
+
+void *raviX_malloc(struct memory_context *memory, size_t size) {
+  memory = counted_request(memory, size);
+  void *ptr = memory->hooks.alloc(memory->hooks.user_data, size);
+  if (ptr == NULL && size != 0)
+    raviX_out_of_memory(memory);
+  return ptr;
+}
+
+void *raviX_calloc(struct memory_context *memory, size_t count, size_t size) {
+  void *ptr = raviX_try_calloc(memory, count, size);
+  if (ptr == NULL && count != 0 && size != 0)
+    raviX_out_of_memory(memory ? memory : &raviX_default_memory);
+  return ptr;
+}
+
+void *raviX_realloc(struct memory_context *memory, void *ptr, size_t size) {
+  void *newptr = raviX_try_realloc(memory, ptr, size);
+  if (newptr == NULL && size != 0)
+    raviX_out_of_memory(memory ? memory : &raviX_default_memory);
+  return newptr;
+}
+
+void raviX_free(struct memory_context *memory, void *ptr) {
+  if (!memory)
+    memory = &raviX_default_memory;
+  if (ptr)
+    memory->hooks.free(memory->hooks.user_data, ptr);
+}
+
+/* blobs are not cleared here, each object is zeroed as it is handed out */
+static void *blob_alloc(struct memory_context *memory, size_t size) {
+  return raviX_malloc(memory, size);
+}
+
+static void blob_free(struct memory_context *memory, void *addr, size_t size) {
   (void)size;
-  free(addr);
+  raviX_free(memory, addr);
 }
 
 void raviX_allocator_init(struct allocator *A, const char *name, size_t size,
-                    unsigned int alignment, unsigned int chunking) {
+                    unsigned int alignment, unsigned int chunking,
+                    struct memory_context *memory) {
   A->name_ = name;
+  A->memory_ = memory;
   A->blobs_ = NULL;
+  A->spare_blobs_ = NULL;
+  A->large_blobs_ = NULL;
   A->size_ = size;
   A->alignment_ = alignment;
   A->chunking_ = chunking;
@@ -68,13 +159,35 @@ void raviX_allocator_init(struct allocator *A, const char *name, size_t size,
   A->useful_bytes = 0;
 }
 
-void *raviX_allocator_allocate(struct allocator *A, size_t extra) {
+/*
+* An object larger than a chunk gets a blob sized to fit it. The blob is
+* kept on its own list so that the current chunk stays in use, and so that
+* raviX_allocator_reset() can give it back rather than keep it as a spare.
+* For such blobs offset records the size of the object and left is 0.
+*/
+static void *allocate_large(struct allocator *A, size_t size, size_t offset) {
+  struct allocation_blob *blob =
+      (struct allocation_blob *)blob_alloc(A->memory_, offset + size);
+  blob->next = A->large_blobs_;
+  blob->left = 0;
+  blob->offset = offset - offsetof(struct allocation_blob, data) + size;
+  A->large_blobs_ = blob;
+  A->total_bytes += offset + size;
+  void *retval = (unsigned char *)blob + offset;
+  memset(retval, 0, size);
+  return retval;
+}
+
+static size_t large_blob_size(struct allocation_blob *blob) {
+  return offsetof(struct allocation_blob, data) + blob->offset;
+}
+
+void *raviX_allocator_allocate_slow(struct allocator *A, size_t extra) {
   size_t size = extra + A->size_;
   size_t alignment = A->alignment_;
   struct allocation_blob *blob = A->blobs_;
   void *retval;
 
-  assert(size <= A->chunking_);
   /*
   * NOTE! The freelist only works with things that are
   *  (a) sufficiently aligned
@@ -90,56 +203,130 @@ void *raviX_allocator_allocate(struct allocator *A, size_t extra) {
     return retval;
   }
 
+#ifdef RAVICOMP_ALLOCATOR_STATS
   A->allocations++;
   A->useful_bytes += size;
+#endif
   size = (size + alignment - 1) & ~(alignment - 1);
   if (!blob || blob->left < size) {
-    size_t offset, chunking = A->chunking_;
-    struct allocation_blob *newblob =
-        (struct allocation_blob *)blob_alloc(chunking);
-    if (!newblob) {
-      fprintf(stderr, "out of memory\n");
-      abort();
+    size_t offset = offsetof(struct allocation_blob, data);
+    offset = (offset + alignment - 1) & ~(alignment - 1);
+    if (size > A->chunking_ - offset)
+      return allocate_large(A, size, offset);
+    size_t chunking = A->chunking_;
+    struct allocation_blob *newblob = A->spare_blobs_;
+    if (newblob) {
+      /* reuse a blob kept by raviX_allocator_reset() */
+      A->spare_blobs_ = newblob->next;
+    } else {
+      newblob = (struct allocation_blob *)blob_alloc(A->memory_, chunking);
+      A->total_bytes += chunking;
     }
-    A->total_bytes += chunking;
     newblob->next = blob;
     blob = newblob;
     A->blobs_ = newblob;
-    offset = offsetof(struct allocation_blob, data);
-    offset = (offset + alignment - 1) & ~(alignment - 1);
     blob->left = chunking - offset;
     blob->offset = offset - offsetof(struct allocation_blob, data);
   }
   retval = blob->data + blob->offset;
   blob->offset += size;
   blob->left -= size;
+  memset(retval, 0, size);
   return retval;
 }
 
+/*
+* Walks the blobs rather than counting as objects are handed out, so
+* that the allocation fast path does not pay for statistics.
+*/
+void raviX_allocator_get_stats(const struct allocator *A,
+                               struct compiler_allocator_stats *stats) {
+  size_t start = offsetof(struct allocation_blob, data);
+  start = ((start + A->alignment_ - 1) & ~((size_t)A->alignment_ - 1)) -
+          offsetof(struct allocation_blob, data);
+  size_t used = 0;
+  for (const struct allocation_blob *blob = A->blobs_; blob; blob = blob->next)
+    used += blob->offset - start;
+  for (const struct allocation_blob *blob = A->large_blobs_; blob;
+       blob = blob->next)
+    used += blob->offset - start;
+  stats->name = A->name_;
+  stats->total_bytes = A->total_bytes;
+  stats->used_bytes = used;
+  stats->objects = 0;
+  if (A->size_ != 0) {
+    size_t size = (A->size_ + A->alignment_ - 1) & ~((size_t)A->alignment_ - 1);
+    size_t objects = used / size;
+    for (void **p = (void **)A->freelist_; p && objects > 0; p = (void **)*p)
+      objects--;
+    stats->objects = objects;
+  }
+}
+
 void raviX_allocator_free(struct allocator *A, void *entry) {
   void **p = (void **)entry;
   *p = A->freelist_;
   A->freelist_ = p;
 }
 void raviX_allocator_show_allocations(struct allocator *A) {
+#ifndef RAVICOMP_ALLOCATOR_STATS
+  fprintf(stderr, "%s: %d total bytes\n", A->name_, (int)A->total_bytes);
+#else
   fprintf(stderr, "%s: %d allocations, %d bytes (%d total bytes, "
                   "%6.2f%% usage, %6.2f average size)\n",
           A->name_, (int)A->allocations, (int)A->useful_bytes,
           (int)A->total_bytes, 100 * (double)A->useful_bytes / A->total_bytes,
           (double)A->useful_bytes / A->allocations);
+#endif
+}
+static void free_blobs(struct memory_context *memory,
+                       struct allocation_blob *blob, size_t chunking) {
+  while (blob) {
+    struct allocation_blob *next = blob->next;
+    blob_free(memory, blob, chunking);
+    blob = next;
+  }
 }
 void raviX_allocator_drop_all_allocations(struct allocator *A) {
   struct allocation_blob *blob = A->blobs_;
+  struct allocation_blob *spare = A->spare_blobs_;
+  struct allocation_blob *large = A->large_blobs_;
   A->blobs_ = NULL;
+  A->spare_blobs_ = NULL;
+  A->large_blobs_ = NULL;
   A->allocations = 0;
   A->total_bytes = 0;
   A->useful_bytes = 0;
   A->freelist_ = NULL;
+  free_blobs(A->memory_, blob, A->chunking_);
+  free_blobs(A->memory_, spare, A->chunking_);
+  free_blobs(A->memory_, large, A->chunking_);
+}
+/*
+* Forgets every allocation but keeps the blobs, so that an allocator
+* that is used again allocates from memory it already has. Large
+* objects are freed, as the next use is unlikely to need the same sizes.
+*/
+void raviX_allocator_reset(struct allocator *A) {
+  struct allocation_blob *blob = A->large_blobs_;
+  while (blob) {
+    struct allocation_blob *next = blob->next;
+    A->total_bytes -= large_blob_size(blob);
+    blob_free(A->memory_, blob, large_blob_size(blob));
+    blob = next;
+  }
+  A->large_blobs_ = NULL;
+  blob = A->blobs_;
   while (blob) {
     struct allocation_blob *next = blob->next;
-    blob_free(blob, A->chunking_);
+    blob->next = A->spare_blobs_;
+    A->spare_blobs_ = blob;
     blob = next;
   }
+  A->blobs_ = NULL;
+  A->allocations = 0;
+  A->useful_bytes = 0;
+  A->freelist_ = NULL;
 }
 void raviX_allocator_destroy(struct allocator *A) {
   raviX_allocator_drop_all_allocations(A);
@@ -152,7 +339,11 @@ void raviX_allocator_destroy(struct allocator *A) {
 void raviX_allocator_transfer(struct allocator *A, struct allocator *transfer_to) {
   assert(transfer_to->blobs_ == NULL);
   assert(transfer_to->freelist_ == NULL);
+  assert(transfer_to->spare_blobs_ == NULL);
+  assert(transfer_to->large_blobs_ == NULL);
   transfer_to->blobs_ = A->blobs_;
+  transfer_to->spare_blobs_ = A->spare_blobs_;
+  transfer_to->large_blobs_ = A->large_blobs_;
   transfer_to->allocations = A->allocations;
   transfer_to->total_bytes = A->total_bytes;
   transfer_to->useful_bytes = A->useful_bytes;
@@ -160,7 +351,10 @@ void raviX_allocator_transfer(struct allocator *A, struct allocator *transfer_to
   transfer_to->alignment_ = A->alignment_;
   transfer_to->chunking_ = A->chunking_;
   transfer_to->size_ = A->size_;
+  transfer_to->memory_ = A->memory_;
   A->blobs_ = NULL;
+  A->spare_blobs_ = NULL;
+  A->large_blobs_ = NULL;
   A->allocations = 0;
   A->total_bytes = 0;
   A->useful_bytes = 0;
@@ -176,7 +370,7 @@ struct foo {
 int raviX_test_allocator() {
   struct allocator alloc;
   raviX_allocator_init(&alloc, "foo", sizeof(struct foo), __alignof__(struct foo),
-                 sizeof(struct allocation_blob) + sizeof(struct foo) * 2);
+                 sizeof(struct allocation_blob) + sizeof(struct foo) * 2, NULL);
   struct foo *t1 = (struct foo *)raviX_allocator_allocate(&alloc, 0);
   if (t1 == NULL)
     return 1;
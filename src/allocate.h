@@ -38,6 +38,10 @@
 * Copyright (C) 2017 Dibyendu Majumdar
 */
 
+#include "ravi_compiler.h"
+
+#include <setjmp.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -47,6 +51,33 @@
 extern "C" {
 #endif
 
+/*
+* The memory hooks used by a compiler state and by everything it owns.
+* raviX_malloc() and friends never return NULL: when the hooks fail they
+* longjmp to env if it is set, after marking the context as failed, and
+* abort otherwise. env is only set while the compiler state is inside
+* one of the api calls that catch errors.
+*/
+struct memory_context {
+	struct memory_allocator hooks;
+	jmp_buf *env;
+	bool failed;
+	uint64_t bytes_requested; /* by allocations and reallocations made through the context */
+};
+
+/* malloc, realloc and free; failures abort */
+extern struct memory_context raviX_default_memory;
+
+extern void raviX_memory_init(struct memory_context *memory, const struct memory_allocator *hooks);
+extern void *raviX_malloc(struct memory_context *memory, size_t size);
+extern void *raviX_calloc(struct memory_context *memory, size_t count, size_t size);
+extern void *raviX_realloc(struct memory_context *memory, void *ptr, size_t size);
+extern void raviX_free(struct memory_context *memory, void *ptr);
+/* these return NULL when the hooks fail, for callers that report the failure themselves */
+extern void *raviX_try_calloc(struct memory_context *memory, size_t count, size_t size);
+extern void *raviX_try_realloc(struct memory_context *memory, void *ptr, size_t size);
+/* reports a failed try allocation the way raviX_malloc() would */
+extern void raviX_out_of_memory(struct memory_context *memory);
 
 struct allocation_blob {
 	struct allocation_blob *next;
@@ -64,7 +95,10 @@ struct allocation_blob {
 
 struct allocator {
 	const char *name_;
+	struct memory_context *memory_;
 	struct allocation_blob *blobs_;
+	struct allocation_blob *spare_blobs_; /* blobs kept by raviX_allocator_reset() for reuse */
+	struct allocation_blob *large_blobs_; /* one blob per object that does not fit in a chunk */
 	size_t size_;
 	unsigned int alignment_;
 	unsigned int chunking_;
@@ -72,17 +106,52 @@ struct allocator {
 	size_t allocations, total_bytes, useful_bytes;
 };
 
+/* memory may be NULL, blobs then come from raviX_default_memory */
 extern void raviX_allocator_init(struct allocator *A, const char *name, size_t size,
-			   unsigned int alignment, unsigned int chunking);
+			   unsigned int alignment, unsigned int chunking, struct memory_context *memory);
 
-extern void *raviX_allocator_allocate(struct allocator *A, size_t extra);
+/*
+* Stats are only kept for every allocation when RAVICOMP_ALLOCATOR_STATS
+* is defined, otherwise only total_bytes is maintained. Objects too big
+* for a chunk get a blob of their own, which is freed with the others.
+*/
+extern void *raviX_allocator_allocate_slow(struct allocator *A, size_t extra);
+
+/*
+* Fast path: bump the offset in the current blob and zero the object.
+* Blobs are not cleared when they are allocated, so only memory that is
+* handed out gets touched. Anything else - a non-empty freelist, no blob
+* or not enough room - goes to the slow path.
+*/
+static inline void *raviX_allocator_allocate(struct allocator *A, size_t extra)
+{
+	size_t size = (extra + A->size_ + A->alignment_ - 1) & ~((size_t)A->alignment_ - 1);
+	struct allocation_blob *blob = A->blobs_;
+	if (A->freelist_ == NULL && blob != NULL && blob->left >= size) {
+		void *retval = blob->data + blob->offset;
+		blob->offset += size;
+		blob->left -= size;
+		memset(retval, 0, size);
+#ifdef RAVICOMP_ALLOCATOR_STATS
+		A->allocations++;
+		A->useful_bytes += extra + A->size_;
+#endif
+		return retval;
+	}
+	return raviX_allocator_allocate_slow(A, extra);
+}
 
 extern void raviX_allocator_free(struct allocator *A, void *entry);
 
+/* objects is only counted for allocators created with a non-zero size */
+extern void raviX_allocator_get_stats(const struct allocator *A, struct compiler_allocator_stats *stats);
+
 extern void raviX_allocator_show_allocations(struct allocator *A);
 
 extern void raviX_allocator_drop_all_allocations(struct allocator *A);
 
+extern void raviX_allocator_reset(struct allocator *A);
+
 extern void raviX_allocator_destroy(struct allocator *A);
 
 extern void raviX_allocator_transfer(struct allocator *A,
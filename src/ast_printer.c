@@ -34,29 +34,37 @@ static const char *type_name(ravitype_t tt)
 	}
 }
 
+/* string objects are not 0 terminated when they point into the source; as with "%.*s" an embedded 0
+ * ends the output */
+static inline void add_string_object(membuff_t *buf, const struct string_object *s)
+{
+	const char *nul = (const char *)memchr(s->str, 0, s->len);
+	raviX_buffer_add_bytes(buf, s->str, nul ? (size_t)(nul - s->str) : s->len);
+}
+
 static void printf_buf(membuff_t *buf, const char *format, ...)
 {
-	static const char *PADDING = "                                                                                ";
-	char tbuf[128] = {0};
+	static const char PADDING[] = "                                                                                ";
 	va_list ap;
 	const char *cp;
 	va_start(ap, format);
 	for (cp = format; *cp; cp++) {
 		if (cp[0] == '%' && cp[1] == 'p') { /* padding */
 			int level = va_arg(ap, int);
-			snprintf(tbuf, sizeof tbuf, "%.*s", level, PADDING);
-			raviX_buffer_add_string(buf, tbuf);
+			if (level > (int)sizeof PADDING - 1)
+				level = (int)sizeof PADDING - 1;
+			raviX_buffer_add_bytes(buf, PADDING, level > 0 ? (size_t)level : 0);
 			cp++;
-		} else if (cp[0] == '%' && cp[1] == 't') { /* string_object */
+		} else if (cp[0] == '%' && cp[1] == 't') { /* string_object, may be NULL */
 			const struct string_object *s = va_arg(ap, const struct string_object *);
-			raviX_buffer_add_string(buf, s->str);
+			if (s)
+				add_string_object(buf, s);
 			cp++;
 		} else if (cp[0] == '%' && cp[1] == 'T') { /* struct var_type */
 			const struct var_type *type;
 			type = va_arg(ap, const struct var_type *);
 			if (type->type_code == RAVI_TUSERDATA) {
-				const struct string_object *s = type->type_name;
-				raviX_buffer_add_string(buf, s->str);
+				add_string_object(buf, type->type_name);
 			} else {
 				raviX_buffer_add_string(buf, type_name(type->type_code));
 			}
@@ -69,7 +77,8 @@ static void printf_buf(membuff_t *buf, const char *format, ...)
 		} else if (cp[0] == '%' && cp[1] == 'c') { /* comment */
 			const char *s;
 			s = va_arg(ap, const char *);
-			raviX_buffer_add_fstring(buf, "--%s", s);
+			raviX_buffer_add_bytes(buf, "--", 2);
+			raviX_buffer_add_string(buf, s);
 			cp++;
 		} else if (cp[0] == '%' && cp[1] == 'i') { /* integer */
 			lua_Integer i;
@@ -79,15 +88,18 @@ static void printf_buf(membuff_t *buf, const char *format, ...)
 		} else if (cp[0] == '%' && cp[1] == 'f') { /* float */
 			double d;
 			d = va_arg(ap, double);
-			raviX_buffer_add_fstring(buf, "%.16f", d);
+			raviX_buffer_add_double(buf, d, 16);
 			cp++;
 		} else if (cp[0] == '%' && cp[1] == 'b') { /* boolean */
 			lua_Integer i;
 			i = va_arg(ap, lua_Integer);
 			raviX_buffer_add_bool(buf, i != 0);
 			cp++;
-		} else {
-			raviX_buffer_add_char(buf, *cp);
+		} else { /* copy the text up to the next conversion in one go */
+			const char *next = strchr(cp + 1, '%');
+			size_t len = next ? (size_t)(next - cp) : strlen(cp);
+			raviX_buffer_add_bytes(buf, cp, len);
+			cp += len - 1;
 		}
 	}
 	va_end(ap);
@@ -97,7 +109,7 @@ static void print_ast_node_list(membuff_t *buf, struct ast_node_list *list, int
 {
 	struct ast_node *node;
 	bool is_first = true;
-	FOR_EACH_PTR(list, node)
+	FOR_EACH_FROZEN_PTR(list, node)
 	{
 		if (is_first)
 			is_first = false;
@@ -105,7 +117,7 @@ static void print_ast_node_list(membuff_t *buf, struct ast_node_list *list, int
 			printf_buf(buf, "%p%s\n", level, delimiter);
 		raviX_print_ast_node(buf, node, level + 1);
 	}
-	END_FOR_EACH_PTR(node);
+	END_FOR_EACH_FROZEN_PTR(node);
 }
 
 static void print_statement_list(membuff_t *buf, struct ast_node_list *statement_list, int level)
@@ -113,25 +125,24 @@ static void print_statement_list(membuff_t *buf, struct ast_node_list *statement
 	print_ast_node_list(buf, statement_list, level + 1, NULL);
 }
 
-static inline const char *get_as_str(const struct string_object *ts) { return ts ? ts->str : ""; }
 
 static void print_symbol(membuff_t *buf, struct lua_symbol *sym, int level)
 {
 	switch (sym->symbol_type) {
 	case SYM_GLOBAL: {
-		printf_buf(buf, "%p%t %c %s %s\n", level, sym->variable.var_name, "global symbol",
-			   type_name(sym->variable.value_type.type_code), get_as_str(sym->variable.value_type.type_name));
+		printf_buf(buf, "%p%t %c %s %t\n", level, sym->variable.var_name, "global symbol",
+			   type_name(sym->variable.value_type.type_code), sym->variable.value_type.type_name);
 		break;
 	}
 	case SYM_LOCAL: {
-		printf_buf(buf, "%p%t %c %s %s\n", level, sym->variable.var_name, "local symbol",
-			   type_name(sym->variable.value_type.type_code), get_as_str(sym->variable.value_type.type_name));
+		printf_buf(buf, "%p%t %c %s %t\n", level, sym->variable.var_name, "local symbol",
+			   type_name(sym->variable.value_type.type_code), sym->variable.value_type.type_name);
 		break;
 	}
 	case SYM_UPVALUE: {
-		printf_buf(buf, "%p%t %c %s %s\n", level, sym->upvalue.target_variable->variable.var_name, "upvalue",
+		printf_buf(buf, "%p%t %c %s %t\n", level, sym->upvalue.target_variable->variable.var_name, "upvalue",
 			   type_name(sym->upvalue.target_variable->variable.value_type.type_code),
-			   get_as_str(sym->upvalue.target_variable->variable.value_type.type_name));
+			   sym->upvalue.target_variable->variable.value_type.type_name);
 		break;
 	}
 	default:
@@ -160,7 +171,7 @@ static void print_symbol_list(membuff_t *buf, struct lua_symbol_list *list, int
 {
 	struct lua_symbol *node;
 	bool is_first = true;
-	FOR_EACH_PTR(list, node)
+	FOR_EACH_FROZEN_PTR(list, node)
 	{
 		if (is_first)
 			is_first = false;
@@ -168,14 +179,14 @@ static void print_symbol_list(membuff_t *buf, struct lua_symbol_list *list, int
 			printf_buf(buf, "%p%s\n", level, delimiter);
 		print_symbol(buf, node, level + 1);
 	}
-	END_FOR_EACH_PTR(node);
+	END_FOR_EACH_FROZEN_PTR(node);
 }
 
 static void print_symbol_names(membuff_t *buf, struct lua_symbol_list *list)
 {
 	struct lua_symbol *node;
 	bool is_first = true;
-	FOR_EACH_PTR(list, node)
+	FOR_EACH_FROZEN_PTR(list, node)
 	{
 		if (is_first)
 			is_first = false;
@@ -183,7 +194,7 @@ static void print_symbol_names(membuff_t *buf, struct lua_symbol_list *list)
 			printf_buf(buf, ", ");
 		print_symbol_name(buf, node);
 	}
-	END_FOR_EACH_PTR(node);
+	END_FOR_EACH_FROZEN_PTR(node);
 }
 
 static const char *get_unary_opr_str(UnaryOperatorType op)
@@ -354,7 +365,7 @@ void raviX_print_ast_node(membuff_t *buf, struct ast_node *node, int level)
 	case STMT_IF: {
 		struct ast_node *test_then_block;
 		bool is_first = true;
-		FOR_EACH_PTR(node->if_stmt.if_condition_list, test_then_block)
+		FOR_EACH_FROZEN_PTR(node->if_stmt.if_condition_list, test_then_block)
 		{
 			if (is_first) {
 				is_first = false;
@@ -366,7 +377,7 @@ void raviX_print_ast_node(membuff_t *buf, struct ast_node *node, int level)
 			print_ast_node_list(buf, test_then_block->test_then_block.test_then_statement_list, level + 1,
 					    NULL);
 		}
-		END_FOR_EACH_PTR(node);
+		END_FOR_EACH_FROZEN_PTR(node);
 		if (node->if_stmt.else_block) {
 			printf_buf(buf, "%pelse\n", level);
 			print_ast_node_list(buf, node->if_stmt.else_statement_list, level + 1, NULL);
@@ -519,11 +530,25 @@ void raviX_print_ast_node(membuff_t *buf, struct ast_node *node, int level)
 	}
 }
 
-void raviX_output_ast(struct compiler_state *container, FILE *fp)
+int raviX_write_ast(struct compiler_state *container, raviX_Writer writer, void *writer_data)
 {
+	if (container->main_function == NULL)
+		return 0; /* not parsed, or released after linearizing */
 	membuff_t mbuf;
-	raviX_buffer_init(&mbuf, 1024);
-	raviX_print_ast_node(&mbuf, container->main_function, 0);
-	fputs(mbuf.buf, fp);
+	memset(&mbuf, 0, sizeof mbuf); /* nothing to free if the buffer cannot be allocated */
+	raviX_catch_memory_errors(container);
+	int rc = setjmp(container->env);
+	if (rc == 0) {
+		raviX_buffer_init_with_writer(&mbuf, OUTPUT_CHUNK_SIZE, &container->memory, writer, writer_data);
+		raviX_print_ast_node(&mbuf, container->main_function, 0);
+		raviX_buffer_flush(&mbuf);
+	}
+	raviX_end_memory_errors(container);
 	raviX_buffer_free(&mbuf);
+	return rc;
+}
+
+int raviX_output_ast(struct compiler_state *container, FILE *fp)
+{
+	return raviX_write_ast(container, raviX_buffer_write_to_file, fp);
 }
@@ -30,8 +30,8 @@ void raviX_function_foreach_child(const struct function_expression *function_exp
 						   const struct function_expression *function_expression))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(function_expression->child_functions, node) { callback(userdata, &node->function_expr); }
-	END_FOR_EACH_PTR(node)
+	FOR_EACH_FROZEN_PTR(function_expression->child_functions, node) { callback(userdata, &node->function_expr); }
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct block_scope *raviX_function_scope(const struct function_expression *function_expression)
 {
@@ -41,34 +41,35 @@ void raviX_function_foreach_statement(const struct function_expression *function
 				      void (*callback)(void *userdata, const struct statement *statement))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(function_expression->function_statement_list, node)
+	FOR_EACH_FROZEN_PTR(function_expression->function_statement_list, node)
 	{
 		assert(node->type <= STMT_EXPR);
 		callback(userdata, (struct statement *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 enum ast_node_type raviX_statement_type(const struct statement *statement) { return statement->type; }
+uint32_t raviX_statement_offset(const struct statement *statement) { return statement->offset; }
 void raviX_function_foreach_argument(const struct function_expression *function_expression, void *userdata,
 				     void (*callback)(void *userdata, const struct lua_variable_symbol *symbol))
 {
 	struct lua_symbol *symbol;
-	FOR_EACH_PTR(function_expression->args, symbol) { callback(userdata, &symbol->variable); }
-	END_FOR_EACH_PTR(symbol)
+	FOR_EACH_FROZEN_PTR(function_expression->args, symbol) { callback(userdata, &symbol->variable); }
+	END_FOR_EACH_FROZEN_PTR(symbol)
 }
 void raviX_function_foreach_local(const struct function_expression *function_expression, void *userdata,
 				  void (*callback)(void *userdata, const struct lua_variable_symbol *lua_local_symbol))
 {
 	struct lua_symbol *symbol;
-	FOR_EACH_PTR(function_expression->locals, symbol) { callback(userdata, &symbol->variable); }
-	END_FOR_EACH_PTR(symbol)
+	FOR_EACH_FROZEN_PTR(function_expression->locals, symbol) { callback(userdata, &symbol->variable); }
+	END_FOR_EACH_FROZEN_PTR(symbol)
 }
 void raviX_function_foreach_upvalue(const struct function_expression *function_expression, void *userdata,
 				    void (*callback)(void *userdata, const struct lua_upvalue_symbol *symbol))
 {
 	struct lua_symbol *symbol;
-	FOR_EACH_PTR(function_expression->upvalues, symbol) { callback(userdata, &symbol->upvalue); }
-	END_FOR_EACH_PTR(symbol)
+	FOR_EACH_FROZEN_PTR(function_expression->upvalues, symbol) { callback(userdata, &symbol->upvalue); }
+	END_FOR_EACH_FROZEN_PTR(symbol)
 }
 
 const struct string_object *raviX_variable_symbol_name(const struct lua_variable_symbol *lua_local_symbol)
@@ -143,6 +144,7 @@ const struct for_statement *raviX_for_statement(const struct statement *stmt)
 	return &n(stmt)->for_stmt;
 }
 enum ast_node_type raviX_expression_type(const struct expression *expression) { return expression->type; }
+uint32_t raviX_expression_offset(const struct expression *expression) { return expression->offset; }
 const struct literal_expression *raviX_literal_expression(const struct expression *expr)
 {
 	assert(expr->type == EXPR_LITERAL);
@@ -200,12 +202,12 @@ void raviX_return_statement_foreach_expression(const struct return_statement *st
 					       void (*callback)(void *, const struct expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->expr_list, node)
+	FOR_EACH_FROZEN_PTR(statement->expr_list, node)
 	{
 		assert(node->type >= EXPR_LITERAL && node->type <= EXPR_FUNCTION_CALL);
 		callback(userdata, (struct expression *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 
 const struct string_object *raviX_label_statement_label_name(const struct label_statement *statement)
@@ -231,45 +233,45 @@ void raviX_local_statement_foreach_expression(const struct local_statement *stat
 					      void (*callback)(void *, const struct expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->expr_list, node)
+	FOR_EACH_FROZEN_PTR(statement->expr_list, node)
 	{
 		assert(node->type >= EXPR_LITERAL && node->type <= EXPR_FUNCTION_CALL);
 		callback(userdata, (struct expression *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 void raviX_local_statement_foreach_symbol(const struct local_statement *statement, void *userdata,
 					  void (*callback)(void *, const struct lua_variable_symbol *expr))
 {
 	struct lua_symbol *symbol;
-	FOR_EACH_PTR(statement->var_list, symbol)
+	FOR_EACH_FROZEN_PTR(statement->var_list, symbol)
 	{
 		assert(symbol->symbol_type == SYM_LOCAL);
 		callback(userdata, &symbol->variable);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 void raviX_expression_statement_foreach_lhs_expression(const struct expression_statement *statement, void *userdata,
 						       void (*callback)(void *, const struct expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->var_expr_list, node)
+	FOR_EACH_FROZEN_PTR(statement->var_expr_list, node)
 	{
 		assert(node->type >= EXPR_LITERAL && node->type <= EXPR_FUNCTION_CALL);
 		callback(userdata, (struct expression *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 void raviX_expression_statement_foreach_rhs_expression(const struct expression_statement *statement, void *userdata,
 						       void (*callback)(void *, const struct expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->expr_list, node)
+	FOR_EACH_FROZEN_PTR(statement->expr_list, node)
 	{
 		assert(node->type >= EXPR_LITERAL && node->type <= EXPR_FUNCTION_CALL);
 		callback(userdata, (struct expression *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct symbol_expression *raviX_function_statement_name(const struct function_statement *statement)
 {
@@ -294,12 +296,12 @@ void raviX_function_statement_foreach_selector(const struct function_statement *
 					       void (*callback)(void *, const struct index_expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->selectors, node)
+	FOR_EACH_FROZEN_PTR(statement->selectors, node)
 	{
 		assert(node->type == EXPR_Y_INDEX || node->type == EXPR_FIELD_SELECTOR);
 		callback(userdata, &node->index_expr);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct function_expression *raviX_function_ast(const struct function_statement *statement)
 {
@@ -311,12 +313,12 @@ void raviX_do_statement_foreach_statement(const struct do_statement *statement,
 					  void (*callback)(void *userdata, const struct statement *statement))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->do_statement_list, node)
+	FOR_EACH_FROZEN_PTR(statement->do_statement_list, node)
 	{
 		assert(node->type <= STMT_EXPR);
 		callback(userdata, (struct statement *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct block_scope *raviX_test_then_statement_scope(const struct test_then_statement *statement)
 {
@@ -326,12 +328,12 @@ void raviX_test_then_statement_foreach_statement(const struct test_then_statemen
 						 void (*callback)(void *userdata, const struct statement *statement))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->test_then_statement_list, node)
+	FOR_EACH_FROZEN_PTR(statement->test_then_statement_list, node)
 	{
 		assert(node->type <= STMT_EXPR);
 		callback(userdata, (struct statement *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct expression *raviX_test_then_statement_condition(const struct test_then_statement *statement)
 {
@@ -342,12 +344,12 @@ void raviX_if_statement_foreach_test_then_statement(const struct if_statement *s
 						    void (*callback)(void *, const struct test_then_statement *stmt))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->if_condition_list, node)
+	FOR_EACH_FROZEN_PTR(statement->if_condition_list, node)
 	{
 		assert(node->type == STMT_TEST_THEN);
 		callback(userdata, &node->test_then_block);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct block_scope *raviX_if_then_statement_else_scope(const struct if_statement *statement)
 {
@@ -357,12 +359,12 @@ void raviX_if_statement_foreach_else_statement(const struct if_statement *statem
 					       void (*callback)(void *userdata, const struct statement *statement))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->else_statement_list, node)
+	FOR_EACH_FROZEN_PTR(statement->else_statement_list, node)
 	{
 		assert(node->type <= STMT_EXPR);
 		callback(userdata, (struct statement *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 
 const struct expression *raviX_while_or_repeat_statement_condition(const struct while_or_repeat_statement *statement)
@@ -380,12 +382,12 @@ void raviX_while_or_repeat_statement_foreach_statement(const struct while_or_rep
 									const struct statement *statement))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->loop_statement_list, node)
+	FOR_EACH_FROZEN_PTR(statement->loop_statement_list, node)
 	{
 		assert(node->type <= STMT_EXPR);
 		callback(userdata, (struct statement *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct block_scope *raviX_for_statement_scope(const struct for_statement *statement)
 {
@@ -395,23 +397,23 @@ void raviX_for_statement_foreach_symbol(const struct for_statement *statement, v
 					void (*callback)(void *, const struct lua_variable_symbol *expr))
 {
 	struct lua_symbol *symbol;
-	FOR_EACH_PTR(statement->symbols, symbol)
+	FOR_EACH_FROZEN_PTR(statement->symbols, symbol)
 	{
 		assert(symbol->symbol_type == SYM_LOCAL);
 		callback(userdata, &symbol->variable);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 void raviX_for_statement_foreach_expression(const struct for_statement *statement, void *userdata,
 					    void (*callback)(void *, const struct expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->expr_list, node)
+	FOR_EACH_FROZEN_PTR(statement->expr_list, node)
 	{
 		assert(node->type >= EXPR_LITERAL && node->type <= EXPR_FUNCTION_CALL);
 		callback(userdata, (struct expression *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct block_scope *raviX_for_statement_body_scope(const struct for_statement *statement)
 {
@@ -421,12 +423,12 @@ void raviX_for_statement_body_foreach_statement(const struct for_statement *stat
 						void (*callback)(void *userdata, const struct statement *statement))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(statement->for_statement_list, node)
+	FOR_EACH_FROZEN_PTR(statement->for_statement_list, node)
 	{
 		assert(node->type <= STMT_EXPR);
 		callback(userdata, (struct statement *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct var_type *raviX_literal_expression_type(const struct literal_expression *expression)
 {
@@ -512,12 +514,12 @@ void raviX_table_literal_expression_foreach_element(
     void (*callback)(void *, const struct table_element_assignment_expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(expression->expr_list, node)
+	FOR_EACH_FROZEN_PTR(expression->expr_list, node)
 	{
 		assert(node->type == EXPR_TABLE_ELEMENT_ASSIGN);
 		callback(userdata, &node->table_elem_assign_expr);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 
 const struct var_type *raviX_suffixed_expression_type(const struct suffixed_expression *expression)
@@ -534,12 +536,12 @@ void raviX_suffixed_expression_foreach_suffix(const struct suffixed_expression *
 					      void (*callback)(void *, const struct expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(expression->suffix_list, node)
+	FOR_EACH_FROZEN_PTR(expression->suffix_list, node)
 	{
 		assert(node->type >= EXPR_LITERAL && node->type <= EXPR_FUNCTION_CALL);
 		callback(userdata, (struct expression *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 
 const struct var_type *raviX_function_call_expression_type(const struct function_call_expression *expression)
@@ -556,12 +558,12 @@ void raviX_function_call_expression_foreach_argument(const struct function_call_
 						     void (*callback)(void *, const struct expression *expr))
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(expression->arg_list, node)
+	FOR_EACH_FROZEN_PTR(expression->arg_list, node)
 	{
 		assert(node->type >= EXPR_LITERAL && node->type <= EXPR_FUNCTION_CALL);
 		callback(userdata, (struct expression *)node);
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 const struct function_expression *raviX_scope_owning_function(const struct block_scope *scope)
 {
@@ -576,8 +578,8 @@ RAVICOMP_EXPORT void raviX_scope_foreach_symbol(const struct block_scope *scope,
 						void (*callback)(void *userdata, const struct lua_symbol *symbol))
 {
 	struct lua_symbol *symbol;
-	FOR_EACH_PTR(scope->symbol_list, symbol) { callback(userdata, symbol); }
-	END_FOR_EACH_PTR(node)
+	FOR_EACH_FROZEN_PTR(scope->symbol_list, symbol) { callback(userdata, symbol); }
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 enum symbol_type raviX_symbol_type(const struct lua_symbol *symbol) { return symbol->symbol_type; }
 const struct lua_variable_symbol *raviX_symbol_variable(const struct lua_symbol *symbol)
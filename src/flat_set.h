@@ -0,0 +1,176 @@
+#ifndef ravicomp_FLAT_SET_H
+#define ravicomp_FLAT_SET_H
+
+/*
+ * Open addressing hash set of pointers in the style of Abseil's Swiss tables.
+ *
+ * Each slot has a control byte that is either FLAT_SET_EMPTY or the low 7 bits
+ * of the hash of the key in the slot. Slots are probed a group of 16 at a time:
+ * all 16 control bytes of a group are compared with the wanted hash bits at
+ * once, using SSE2 where the compiler targets it, and only keys whose bits
+ * match are compared for equality. The rest of the hash picks the first group
+ * to look at; the following groups are visited in triangular order. Keys are
+ * never removed so there are no tombstones, and the table grows once it is
+ * 7/8 full.
+ *
+ * DECLARE_FLAT_SET(name, key_type, hash_function, equal_function) declares
+ * struct name together with static inline functions name_init(), name_destroy(),
+ * name_clear(), name_reserve(), name_find() and name_insert(). The hash and
+ * equality functions are called directly so that the compiler can inline them.
+ * Memory comes from the memory context given to name_init(), so running out of
+ * memory is reported the way raviX_malloc() reports it.
+ */
+
+#include "allocate.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(RAVICOMP_NO_SIMD) &&                                                                                      \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FLAT_SET_SSE2 1
+#endif
+
+enum { FLAT_SET_GROUP = 16, FLAT_SET_EMPTY = 0x80 };
+
+/* Bit i of the result is set if control byte i of the group is c */
+static inline uint32_t flat_set_match(const uint8_t *group, uint8_t c)
+{
+#if defined(FLAT_SET_SSE2)
+	__m128i bytes = _mm_loadu_si128((const __m128i *)group);
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)c)));
+#else
+	uint32_t mask = 0;
+	for (int i = 0; i < FLAT_SET_GROUP; i++)
+		mask |= (uint32_t)(group[i] == c) << i;
+	return mask;
+#endif
+}
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline unsigned flat_set_first_bit(uint32_t mask)
+{
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+}
+#else
+static inline unsigned flat_set_first_bit(uint32_t mask) { return (unsigned)__builtin_ctz(mask); }
+#endif
+
+/* Smallest capacity that holds n keys without growing: a power of 2 that is at least one group */
+static inline uint32_t flat_set_capacity_for(uint32_t n)
+{
+	uint32_t capacity = FLAT_SET_GROUP;
+	while (capacity - capacity / 8 < n)
+		capacity *= 2;
+	return capacity;
+}
+
+/* Visits the keys in the set in no particular order; keys must not be added while doing so */
+#define flat_set_foreach(set, key)                                                                                     \
+	for (uint32_t key##index__ = 0; key##index__ < (set)->capacity; key##index__++)                                \
+		if ((set)->ctrl[key##index__] != FLAT_SET_EMPTY && ((key) = (set)->slots[key##index__], 1))
+
+#define DECLARE_FLAT_SET(name, key_type, hash_function, equal_function)                                                \
+	struct name {                                                                                                  \
+		key_type **slots; /* capacity keys, followed by the capacity control bytes */                          \
+		uint8_t *ctrl;                                                                                         \
+		uint32_t capacity; /* 0 until the first key is added, else a power of 2 */                             \
+		uint32_t count;                                                                                        \
+		struct memory_context *memory;                                                                         \
+	};                                                                                                             \
+                                                                                                                       \
+	static inline void name##_init(struct name *set, struct memory_context *memory)                                \
+	{                                                                                                              \
+		memset(set, 0, sizeof *set);                                                                           \
+		set->memory = memory;                                                                                  \
+	}                                                                                                              \
+                                                                                                                       \
+	static inline void name##_destroy(struct name *set)                                                            \
+	{                                                                                                              \
+		raviX_free(set->memory, set->slots);                                                                   \
+		set->slots = NULL;                                                                                     \
+		set->ctrl = NULL;                                                                                      \
+		set->capacity = 0;                                                                                     \
+		set->count = 0;                                                                                        \
+	}                                                                                                              \
+                                                                                                                       \
+	/* Removes all keys, keeping the table */                                                                      \
+	static inline void name##_clear(struct name *set)                                                              \
+	{                                                                                                              \
+		if (set->capacity)                                                                                     \
+			memset(set->ctrl, FLAT_SET_EMPTY, set->capacity);                                              \
+		set->count = 0;                                                                                        \
+	}                                                                                                              \
+                                                                                                                       \
+	/* Puts a key that is not in the set into the first free slot of its probe sequence */                         \
+	static inline void name##_place(struct name *set, uint32_t hash, key_type *key)                                \
+	{                                                                                                              \
+		uint32_t groups_mask = set->capacity / FLAT_SET_GROUP - 1;                                             \
+		uint32_t group = (hash >> 7) & groups_mask;                                                            \
+		for (uint32_t step = 1;; step++) {                                                                     \
+			uint32_t free_slots = flat_set_match(set->ctrl + group * FLAT_SET_GROUP, FLAT_SET_EMPTY);      \
+			if (free_slots) {                                                                              \
+				uint32_t i = group * FLAT_SET_GROUP + flat_set_first_bit(free_slots);                  \
+				set->ctrl[i] = (uint8_t)(hash & 0x7f);                                                 \
+				set->slots[i] = key;                                                                   \
+				return;                                                                                \
+			}                                                                                              \
+			group = (group + step) & groups_mask;                                                          \
+		}                                                                                                      \
+	}                                                                                                              \
+                                                                                                                       \
+	/* Makes room for n keys in all, so that adding them does not grow the table again */                          \
+	static inline void name##_reserve(struct name *set, uint32_t n)                                                \
+	{                                                                                                              \
+		uint32_t capacity = flat_set_capacity_for(n);                                                          \
+		if (capacity <= set->capacity)                                                                         \
+			return;                                                                                        \
+		key_type **slots =                                                                                     \
+		    (key_type **)raviX_malloc(set->memory, (size_t)capacity * (sizeof(key_type *) + 1));               \
+		struct name old = *set;                                                                                \
+		set->slots = slots;                                                                                    \
+		set->ctrl = (uint8_t *)(slots + capacity);                                                             \
+		set->capacity = capacity;                                                                              \
+		memset(set->ctrl, FLAT_SET_EMPTY, capacity);                                                           \
+		for (uint32_t i = 0; i < old.capacity; i++) {                                                          \
+			if (old.ctrl[i] != FLAT_SET_EMPTY)                                                             \
+				name##_place(set, hash_function(old.slots[i]), old.slots[i]);                          \
+		}                                                                                                      \
+		raviX_free(set->memory, old.slots);                                                                    \
+	}                                                                                                              \
+                                                                                                                       \
+	/* Returns the key in the set that is equal to key, or NULL; hash must be the hash of key */                   \
+	static inline key_type *name##_find(const struct name *set, uint32_t hash, key_type *key)                      \
+	{                                                                                                              \
+		if (set->count == 0)                                                                                   \
+			return NULL;                                                                                   \
+		uint32_t groups_mask = set->capacity / FLAT_SET_GROUP - 1;                                             \
+		uint32_t group = (hash >> 7) & groups_mask;                                                            \
+		for (uint32_t step = 1;; step++) {                                                                     \
+			const uint8_t *ctrl = set->ctrl + group * FLAT_SET_GROUP;                                      \
+			for (uint32_t m = flat_set_match(ctrl, (uint8_t)(hash & 0x7f)); m != 0; m &= m - 1) {          \
+				key_type *candidate = set->slots[group * FLAT_SET_GROUP + flat_set_first_bit(m)];      \
+				if (equal_function(key, candidate))                                                    \
+					return candidate;                                                              \
+			}                                                                                              \
+			if (flat_set_match(ctrl, FLAT_SET_EMPTY))                                                      \
+				return NULL;                                                                           \
+			group = (group + step) & groups_mask;                                                          \
+		}                                                                                                      \
+	}                                                                                                              \
+                                                                                                                       \
+	/* Adds a key that is not in the set yet; hash must be the hash of key */                                      \
+	static inline void name##_insert(struct name *set, uint32_t hash, key_type *key)                               \
+	{                                                                                                              \
+		if (set->count >= set->capacity - set->capacity / 8)                                                   \
+			name##_reserve(set, set->count + 1);                                                           \
+		name##_place(set, hash, key);                                                                          \
+		set->count++;                                                                                          \
+	}                                                                                                              \
+	struct name
+
+#endif
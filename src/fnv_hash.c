@@ -38,7 +38,7 @@
 uint32_t
 fnv1_hash_string(const char *key)
 {
-	uint32_t hash = 2166136261ul;
+	uint32_t hash = FNV1_HASH_SEED;
 	const uint8_t *bytes = (uint8_t *)key;
 
 	while (*bytes != 0) {
@@ -53,7 +53,7 @@ fnv1_hash_string(const char *key)
 uint32_t
 fnv1_hash_data(const void *data, size_t size)
 {
-	uint32_t hash = 2166136261ul;
+	uint32_t hash = FNV1_HASH_SEED;
 	const uint8_t *bytes = (uint8_t *)data;
 
 	while (size-- != 0) {
@@ -65,6 +65,12 @@ fnv1_hash_data(const void *data, size_t size)
 	return hash;
 }
 
+uint32_t
+raviX_hash_string(const char *key)
+{
+	return raviX_hash_data(key, strlen(key));
+}
+
 int
 string_key_equals(const void *a, const void *b)
 {
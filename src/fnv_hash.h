@@ -34,18 +34,152 @@
 
 #include <inttypes.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define FNV1_HASH_SEED 2166136261ul
 
 uint32_t fnv1_hash_string(const char *key);
 uint32_t fnv1_hash_data(const void *data, size_t size);
 
+/* wyhash final version 4, released into the public domain by Wang Yi */
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#pragma intrinsic(_umul128)
+#endif
+
+static inline void wymum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	*a = _umul128(*a, *b, b);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+	uint64_t c = t < rl, lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t wymix(uint64_t a, uint64_t b)
+{
+	wymum(&a, &b);
+	return a ^ b;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static inline uint64_t wyr8(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return __builtin_bswap64(v);
+}
+static inline uint64_t wyr4(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return __builtin_bswap32(v);
+}
+#else
+static inline uint64_t wyr8(const uint8_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+static inline uint64_t wyr4(const uint8_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+#endif
+static inline uint64_t wyr3(const uint8_t *p, size_t k)
+{
+	return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
+
+static const uint64_t wyp[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+				0x4d5a2da51de1aa47ull};
+
+/* wyhash (https://github.com/wangyi-fudan/wyhash) reads 8 bytes at a time and has a fast path for
+ * keys up to 16 bytes, which covers most identifiers. The 64-bit result is truncated to 32 bits.
+ * Inline so that the lexer does not make a call per identifier.
+ */
+static inline uint32_t wyhash_data(const void *data, size_t size)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	uint64_t seed = wymix(wyp[0], wyp[1]); /* seed 0 */
+	uint64_t a, b;
+	if (size <= 16) {
+		if (size >= 4) {
+			a = (wyr4(p) << 32) | wyr4(p + ((size >> 3) << 2));
+			b = (wyr4(p + size - 4) << 32) | wyr4(p + size - 4 - ((size >> 3) << 2));
+		} else if (size > 0) {
+			a = wyr3(p, size);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = size;
+		if (i >= 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+				see1 = wymix(wyr8(p + 16) ^ wyp[2], wyr8(p + 24) ^ see1);
+				see2 = wymix(wyr8(p + 32) ^ wyp[3], wyr8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i >= 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = wyr8(p + i - 16);
+		b = wyr8(p + i - 8);
+	}
+	a ^= wyp[1];
+	b ^= seed;
+	wymum(&a, &b);
+	return (uint32_t)wymix(a ^ wyp[0] ^ size, b ^ wyp[1]);
+}
+
+
+/*
+ * The hash used for string objects, and by the string sets and hash tables below. It is
+ * wyhash unless RAVICOMP_FNV_HASH is defined at build time. The hashes stored in the
+ * static keyword strings in lexer.c must be generated for the same hash function.
+ */
+#if defined(RAVICOMP_FNV_HASH)
+#define raviX_hash_data(data, size) fnv1_hash_data(data, size)
+#else
+#define raviX_hash_data(data, size) wyhash_data(data, size)
+#endif
+uint32_t raviX_hash_string(const char *key);
+
+/* Adds one byte to the hash, so that the hash can be computed while scanning the data */
+static inline uint32_t fnv1_hash_byte(uint32_t hash, uint8_t c)
+{
+	return (hash ^ c) * 0x01000193;
+}
+
 int string_key_equals(const void *a, const void *b);
 
 #define hash_table_create_for_string() \
-	raviX_hash_table_create((uint32_t (*)(const void *key))fnv1_hash_string, \
+	raviX_hash_table_create(NULL, (uint32_t (*)(const void *key))raviX_hash_string, \
 			  string_key_equals)
 
 #define set_create_for_string() \
-	set_create((uint32_t (*)(const void *key))fnv1_hash_string, \
+	set_create(NULL, (uint32_t (*)(const void *key))raviX_hash_string, \
 		   string_key_equals)
 
 #endif
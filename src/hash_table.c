@@ -36,6 +36,7 @@
 #include <stdlib.h>
 
 #include <hash_table.h>
+#include "allocate.h"
 
 #define ARRAY_SIZE(array) ((int)(sizeof(array) / sizeof(array[0])))
 
@@ -103,13 +104,14 @@ entry_is_present(const struct hash_entry *entry)
 }
 
 struct hash_table *
-raviX_hash_table_create(uint32_t (*hash_function)(const void *key),
+raviX_hash_table_create(struct memory_context *memory,
+		  uint32_t (*hash_function)(const void *key),
 		  int (*key_equals_function)(const void *a,
 					     const void *b))
 {
 	struct hash_table *ht;
 
-	ht = malloc(sizeof(*ht));
+	ht = raviX_try_calloc(memory, 1, sizeof(*ht));
 	if (ht == NULL)
 		return NULL;
 
@@ -119,12 +121,13 @@ raviX_hash_table_create(uint32_t (*hash_function)(const void *key),
 	ht->max_entries = hash_sizes[ht->size_index].max_entries;
 	ht->hash_function = hash_function;
 	ht->key_equals_function = key_equals_function;
-	ht->table = calloc(ht->size, sizeof(*ht->table));
+	ht->memory = memory;
+	ht->table = raviX_try_calloc(memory, ht->size, sizeof(*ht->table));
 	ht->entries = 0;
 	ht->deleted_entries = 0;
 
 	if (ht->table == NULL) {
-		free(ht);
+		raviX_free(memory, ht);
 		return NULL;
 	}
 
@@ -151,8 +154,8 @@ raviX_hash_table_destroy(struct hash_table *ht,
 			delete_function(entry);
 		}
 	}
-	free(ht->table);
-	free(ht);
+	raviX_free(ht->memory, ht->table);
+	raviX_free(ht->memory, ht);
 }
 
 /**
@@ -212,7 +215,7 @@ hash_table_rehash(struct hash_table *ht, int new_size_index)
 	if (new_size_index >= ARRAY_SIZE(hash_sizes))
 		return;
 
-	table = calloc(hash_sizes[new_size_index].size, sizeof(*ht->table));
+	table = raviX_calloc(ht->memory, hash_sizes[new_size_index].size, sizeof(*ht->table));
 	if (table == NULL)
 		return;
 
@@ -231,7 +234,7 @@ hash_table_rehash(struct hash_table *ht, int new_size_index)
 					     entry->key, entry->data);
 	}
 
-	free(old_ht.table);
+	raviX_free(ht->memory, old_ht.table);
 }
 
 /**
@@ -34,6 +34,8 @@ extern "C" {
 
 #include <inttypes.h>
 
+struct memory_context;
+
 struct hash_entry {
 	uint32_t hash;
 	const void *key;
@@ -50,10 +52,13 @@ struct hash_table {
 	uint32_t size_index;
 	uint32_t entries;
 	uint32_t deleted_entries;
+	struct memory_context *memory;
 };
 
+/* memory may be NULL, the table then uses malloc */
 struct hash_table *
-raviX_hash_table_create(uint32_t (*hash_function)(const void *key),
+raviX_hash_table_create(struct memory_context *memory,
+		  uint32_t (*hash_function)(const void *key),
 		  int (*key_equals_function)(const void *a,
 					     const void *b));
 void
@@ -0,0 +1,72 @@
+/*
+ * String interner shared by compiler states that may be running on different threads.
+ * The strings are spread over shards by hash value, each shard has its own lock, set
+ * and allocators, so that threads interning different strings rarely wait for each other.
+ */
+
+#include "ravi_ast.h"
+#include "threads.h"
+
+enum { SHARD_BITS = 6, SHARD_COUNT = 1 << SHARD_BITS };
+
+struct interner_shard {
+	raviX_mutex lock;
+	struct string_set strings;
+	struct allocator string_object_allocator;
+};
+
+struct string_interner {
+	struct interner_shard shards[SHARD_COUNT];
+};
+
+struct string_interner *raviX_create_string_interner(void)
+{
+	struct string_interner *interner = (struct string_interner *)calloc(1, sizeof(struct string_interner));
+	if (!interner)
+		return NULL;
+	for (int i = 0; i < SHARD_COUNT; i++) {
+		struct interner_shard *shard = &interner->shards[i];
+		raviX_mutex_init(&shard->lock);
+		string_set_init(&shard->strings, NULL);
+		raviX_allocator_init(&shard->string_object_allocator, "string_objects", sizeof(struct string_object),
+				     sizeof(double), STRING_OBJECT_CHUNK, NULL);
+	}
+	return interner;
+}
+
+void raviX_destroy_string_interner(struct string_interner *interner)
+{
+	if (!interner)
+		return;
+	for (int i = 0; i < SHARD_COUNT; i++) {
+		struct interner_shard *shard = &interner->shards[i];
+		string_set_destroy(&shard->strings);
+		raviX_allocator_destroy(&shard->string_object_allocator);
+		raviX_mutex_destroy(&shard->lock);
+	}
+	free(interner);
+}
+
+const struct string_object *raviX_interner_intern(struct string_interner *interner, const char *input, uint32_t len,
+						  uint32_t hash)
+{
+	/* the sets mostly use the low bits of the hash, so the shard is picked by the high bits */
+	struct interner_shard *shard = &interner->shards[hash >> (32 - SHARD_BITS)];
+	struct string_object temp = {.len = len, .str = input, .hash = hash, .reserved = -1};
+	raviX_mutex_lock(&shard->lock);
+	const struct string_object *result = string_set_find(&shard->strings, hash, &temp);
+	if (result == NULL) {
+		struct string_object *new_string = raviX_allocator_allocate(&shard->string_object_allocator, len + 1);
+		char *s = (char *)(new_string + 1); /* characters follow the header, allow for 0 terminator */
+		memcpy(s, input, len);
+		s[len] = 0;
+		new_string->str = s;
+		new_string->len = len;
+		new_string->hash = hash;
+		new_string->reserved = -1;
+		string_set_insert(&shard->strings, hash, new_string);
+		result = new_string;
+	}
+	raviX_mutex_unlock(&shard->lock);
+	return result;
+}
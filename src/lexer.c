@@ -4,23 +4,38 @@
  */
 
 #include "fnv_hash.h"
+#include "numeral.h"
 #include "ravi_ast.h"
+#include "scan.h"
+#include "threads.h"
 
 #include <limits.h>
-#include <locale.h>
-#include <math.h>
 
 enum { EOZ = -1 }; /* end of stream */
 #define cast(t, v) ((t)v)
 #define cast_int(v) cast(int, v)
 #define cast_uchar(c) cast(unsigned char, c)
-#define cast_num(n) cast(lua_Number, n)
 #define l_castU2S(i) ((lua_Integer)(i))
-static inline int zgetc(struct lexer_state *z) { return z->n-- > 0 ? cast_uchar(*z->p++) : EOZ; }
+static int fill(struct lexer_state *z);
+static inline int zgetc(struct lexer_state *z) { return z->n-- > 0 ? cast_uchar(*z->p++) : fill(z); }
 static inline void next(struct lexer_state *ls) { ls->current = zgetc(ls); }
 static inline bool currIsNewline(struct lexer_state *ls) { return ls->current == '\n' || ls->current == '\r'; }
-
-#define lua_getlocaledecpoint() (localeconv()->decimal_point[0])
+/* offset of the current character in the input buffer */
+static inline size_t current_offset(struct lexer_state *ls)
+{
+	return ls->buf_offset + (ls->current == EOZ ? ls->bufsize : (size_t)(ls->p - ls->buf) - 1);
+}
+/* number of characters available in the input starting at the current character */
+static inline size_t available(struct lexer_state *ls) { return ls->current == EOZ ? 0 : ls->n + 1; }
+/* skips 'count' characters starting at the current character, the one following them becomes current */
+static inline void skip(struct lexer_state *ls, size_t count)
+{
+	if (count == 0)
+		return;
+	ls->p += count - 1;
+	ls->n -= count - 1;
+	next(ls);
+}
 
 #define ARRAY_SIZE(array) ((int)(sizeof(array) / sizeof(array[0])))
 /* ORDER TokenType */
@@ -34,45 +49,142 @@ static const char *const luaX_tokens[] = {
 /* Says whether the given string represents a Lua/Ravi keyword  i.e. reserved word */
 static inline int is_reserved(const struct string_object *s) { return s->reserved; }
 
+/*
+** Perfect hash table for the entries in luaX_tokens before "<eof>", i.e. reserved words, operators and
+** the @type tokens. The string objects for these are static and shared by all compiler states.
+** Generated by tools/gen_keywords.py - rerun it if luaX_tokens changes.
+*/
+#define KEYWORD_HASH_BITS 6
+#define KEYWORD_HASH_MULTIPLIER 0xdaa9c44du
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 10
+static const int8_t keyword_slots[1 << KEYWORD_HASH_BITS] = {
+    38, -1, -1, 7, 28, 32, 17, 33, 34, 10, 39, 12, 21, 31, -1, -1,
+    -1, -1, -1, 14, 13, 20, -1, -1, 0, 6, 15, 16, 29, 8, -1, -1,
+    18, -1, 3, -1, 22, 11, 19, 35, 36, 30, 24, -1, -1, -1, -1, 2,
+    -1, -1, 27, 5, -1, 37, 1, -1, -1, 9, 4, 26, -1, 23, 25, -1,
+};
+static const char keyword_text[][KEYWORD_MAX_LEN + 1] = {
+    "and", "break", "do", "else", "elseif", "end", "false", "for",
+    "function", "goto", "if", "in", "local", "defer", "nil", "not",
+    "or", "repeat", "return", "then", "true", "until", "while", "//",
+    "..", "...", "==", ">=", "<=", "~=", "<<", ">>",
+    "::", "@integer", "@number", "@integer[]", "@number[]", "@table", "@string", "@closure",
+};
+#if defined(RAVICOMP_FNV_HASH)
+#define KEYWORD_STRING_HASH(fnv, wyhash) fnv
+#else
+#define KEYWORD_STRING_HASH(fnv, wyhash) wyhash
+#endif
+static const struct string_object keyword_strings[] = {
+    {.len = 3, .reserved = 0, .hash = KEYWORD_STRING_HASH(0x0f29c2a6u, 0xf93b4657u), .str = keyword_text[0]},
+    {.len = 5, .reserved = 1, .hash = KEYWORD_STRING_HASH(0xc9648178u, 0xd643004du), .str = keyword_text[1]},
+    {.len = 2, .reserved = 2, .hash = KEYWORD_STRING_HASH(0x621cd814u, 0xd6f61f0du), .str = keyword_text[2]},
+    {.len = 4, .reserved = 3, .hash = KEYWORD_STRING_HASH(0xbdbf5bf0u, 0xf0af2c36u), .str = keyword_text[3]},
+    {.len = 6, .reserved = 4, .hash = KEYWORD_STRING_HASH(0x54554c87u, 0xe7d5a8deu), .str = keyword_text[4]},
+    {.len = 3, .reserved = 5, .hash = KEYWORD_STRING_HASH(0x6a8e75aau, 0x4fe00cb4u), .str = keyword_text[5]},
+    {.len = 5, .reserved = 6, .hash = KEYWORD_STRING_HASH(0x0b069958u, 0xf02d93a2u), .str = keyword_text[6]},
+    {.len = 3, .reserved = 7, .hash = KEYWORD_STRING_HASH(0xacf38390u, 0x4617eb48u), .str = keyword_text[7]},
+    {.len = 8, .reserved = 8, .hash = KEYWORD_STRING_HASH(0x9ed64249u, 0xeb9e1a14u), .str = keyword_text[8]},
+    {.len = 4, .reserved = 9, .hash = KEYWORD_STRING_HASH(0xf5a30fe6u, 0xb9b59437u), .str = keyword_text[9]},
+    {.len = 2, .reserved = 10, .hash = KEYWORD_STRING_HASH(0x39386e06u, 0xade39882u), .str = keyword_text[10]},
+    {.len = 2, .reserved = 11, .hash = KEYWORD_STRING_HASH(0x41387a9eu, 0xddaf6bf5u), .str = keyword_text[11]},
+    {.len = 5, .reserved = 12, .hash = KEYWORD_STRING_HASH(0x9c436708u, 0xdbbaef3eu), .str = keyword_text[12]},
+    {.len = 5, .reserved = 13, .hash = KEYWORD_STRING_HASH(0x1a01fb3bu, 0x944fc0c9u), .str = keyword_text[13]},
+    {.len = 3, .reserved = 14, .hash = KEYWORD_STRING_HASH(0x0da3f8ecu, 0x5885b7b5u), .str = keyword_text[14]},
+    {.len = 3, .reserved = 15, .hash = KEYWORD_STRING_HASH(0x29b19c8au, 0x1857497du), .str = keyword_text[15]},
+    {.len = 2, .reserved = 16, .hash = KEYWORD_STRING_HASH(0x5d342984u, 0x0cb5e04fu), .str = keyword_text[16]},
+    {.len = 6, .reserved = 17, .hash = KEYWORD_STRING_HASH(0xd99ba82au, 0x5bc55b1du), .str = keyword_text[17]},
+    {.len = 6, .reserved = 18, .hash = KEYWORD_STRING_HASH(0x85ee37bfu, 0x92865b03u), .str = keyword_text[18]},
+    {.len = 4, .reserved = 19, .hash = KEYWORD_STRING_HASH(0xe522e976u, 0x78898307u), .str = keyword_text[19]},
+    {.len = 4, .reserved = 20, .hash = KEYWORD_STRING_HASH(0x4db211e5u, 0x68fbb066u), .str = keyword_text[20]},
+    {.len = 5, .reserved = 21, .hash = KEYWORD_STRING_HASH(0xbab5214fu, 0x5dc26b90u), .str = keyword_text[21]},
+    {.len = 5, .reserved = 22, .hash = KEYWORD_STRING_HASH(0x0dc628ceu, 0x210b2a9cu), .str = keyword_text[22]},
+    {.len = 2, .reserved = 23, .hash = KEYWORD_STRING_HASH(0xa2d266e3u, 0x0bf87a53u), .str = keyword_text[23]},
+    {.len = 2, .reserved = 24, .hash = KEYWORD_STRING_HASH(0xa3d4a70du, 0x6833a5b2u), .str = keyword_text[24]},
+    {.len = 3, .reserved = 25, .hash = KEYWORD_STRING_HASH(0x0ac31c19u, 0x5a1c56e7u), .str = keyword_text[25]},
+    {.len = 2, .reserved = 26, .hash = KEYWORD_STRING_HASH(0x90f4dccfu, 0xfbc8be0fu), .str = keyword_text[26]},
+    {.len = 2, .reserved = 27, .hash = KEYWORD_STRING_HASH(0x10fc6214u, 0x04db5f8du), .str = keyword_text[27]},
+    {.len = 2, .reserved = 28, .hash = KEYWORD_STRING_HASH(0x94f721b2u, 0xbb11fb9cu), .str = keyword_text[28]},
+    {.len = 2, .reserved = 29, .hash = KEYWORD_STRING_HASH(0x905dc7d4u, 0xd06004e3u), .str = keyword_text[29]},
+    {.len = 2, .reserved = 30, .hash = KEYWORD_STRING_HASH(0x95f72345u, 0xeb87a7d8u), .str = keyword_text[30]},
+    {.len = 2, .reserved = 31, .hash = KEYWORD_STRING_HASH(0x13fc66cdu, 0x95d26a5du), .str = keyword_text[31]},
+    {.len = 2, .reserved = 32, .hash = KEYWORD_STRING_HASH(0x980630f5u, 0x57851da2u), .str = keyword_text[32]},
+    {.len = 8, .reserved = 33, .hash = KEYWORD_STRING_HASH(0x55861d6fu, 0xc1fa5bc7u), .str = keyword_text[33]},
+    {.len = 7, .reserved = 34, .hash = KEYWORD_STRING_HASH(0x55b2605eu, 0x50ea2cfau), .str = keyword_text[34]},
+    {.len = 10, .reserved = 35, .hash = KEYWORD_STRING_HASH(0x95543313u, 0x238e20eeu), .str = keyword_text[35]},
+    {.len = 9, .reserved = 36, .hash = KEYWORD_STRING_HASH(0x48f531a6u, 0x4ce60b3du), .str = keyword_text[36]},
+    {.len = 6, .reserved = 37, .hash = KEYWORD_STRING_HASH(0x615f28b1u, 0x1be11c41u), .str = keyword_text[37]},
+    {.len = 7, .reserved = 38, .hash = KEYWORD_STRING_HASH(0x560c148au, 0xc7f0766fu), .str = keyword_text[38]},
+    {.len = 8, .reserved = 39, .hash = KEYWORD_STRING_HASH(0x9f7433a0u, 0x95e88c52u), .str = keyword_text[39]},
+};
+
+/* Returns the index of the string in luaX_tokens if it is one of the static strings above, else -1 */
+static inline int find_keyword(const char *s, size_t len)
+{
+	if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN)
+		return -1;
+	uint32_t key = (uint32_t)cast_uchar(s[0]) | (uint32_t)cast_uchar(s[1]) << 8 |
+		       (uint32_t)cast_uchar(s[len - 1]) << 16 | (uint32_t)len << 24;
+	int i = keyword_slots[(key * KEYWORD_HASH_MULTIPLIER) >> (32 - KEYWORD_HASH_BITS)];
+	if (i < 0 || keyword_strings[i].len != len || memcmp(keyword_strings[i].str, s, len) != 0)
+		return -1;
+	return i;
+}
+
 /*
 Creates a new string object. string objects are interned in a hash set.
-If the string matches a keyword then the reserved attribute will be set to the token id associated
-with the keyword else this attribute will be -1. The hash value of the string is stored the 'hash'
+If the string matches a keyword then the static string object for the keyword is returned,
+its reserved attribute is the token id associated with the keyword; for other strings this attribute
+will be -1. The hash value of the string is stored the 'hash'
 attribute. Note that we need to allow strings that have embedded 0 character hence the length
 is explicit. But all tokens and reserved keywords are expected to be standard C strings.
 */
-const struct string_object *raviX_create_string(struct compiler_state *container, const char *input, uint32_t len)
+static const struct string_object *intern_string(struct compiler_state *container, const char *input, uint32_t len,
+						uint32_t hash, bool borrow)
 {
-	struct string_object temp = {.len = len, .str = input, .hash = fnv1_hash_data(input, len), .reserved = -1};
-	struct set_entry *entry = set_search_pre_hashed(container->strings, temp.hash, &temp);
-	if (entry != NULL)
-		/* found the string */
-		return (const struct string_object *)entry->key;
+	int keyword = find_keyword(input, len);
+	if (keyword >= 0)
+		return &keyword_strings[keyword];
+	if (container->interner)
+		return raviX_interner_intern(container->interner, input, len, hash);
+	struct string_object temp = {.len = len, .str = input, .hash = hash, .reserved = -1};
+	const struct string_object *found = string_set_find(&container->strings, temp.hash, &temp);
+	if (found != NULL)
+		return found;
 	else {
-		struct string_object *new_string = raviX_allocator_allocate(&container->string_object_allocator, 0);
-		char *s = raviX_allocator_allocate(&container->string_allocator, len + 1); /* allow for 0 terminator */
-		memcpy(s, input, len);
-		s[len] = 0; /* 0 terminate string, however string may contain embedded 0 characters */
-		new_string->str = s;
+		struct string_object *new_string;
+		if (borrow) {
+			new_string = raviX_allocator_allocate(&container->string_object_allocator, 0);
+			new_string->str = input; /* caller guarantees that input outlives the compiler state */
+		} else {
+			/* the characters follow the header in the same allocation, allow for 0 terminator */
+			new_string = raviX_allocator_allocate(&container->string_object_allocator, len + 1);
+			char *s = (char *)(new_string + 1);
+			memcpy(s, input, len);
+			s[len] = 0; /* 0 terminate string, however string may contain embedded 0 characters */
+			new_string->str = s;
+		}
 		new_string->len = len;
 		new_string->hash = temp.hash;
 		new_string->reserved = -1;
-		/* Check if this is a keyword, linear search is okay as we do this only when we first
-		 * encounter a keyword
-		 */
-		for (int i = 0; i < ARRAY_SIZE(luaX_tokens); i++) {
-			if (luaX_tokens[i][0] == '<')
-				break; // We have gone past reserved keywords
-			if (strcmp(luaX_tokens[i], s) == 0) {
-				new_string->reserved = i; /* save index of the keyword */
-				break;
-			}
-		}
-		set_add_pre_hashed(container->strings, temp.hash, new_string);
+		string_set_insert(&container->strings, temp.hash, new_string);
 		return new_string;
 	}
 }
 
+const struct string_object *raviX_create_string(struct compiler_state *container, const char *input, uint32_t len)
+{
+	return intern_string(container, input, len, raviX_hash_data(input, len), false);
+}
+
+void raviX_set_zero_copy_strings(struct compiler_state *container, bool enable) { container->zero_copy_strings = enable; }
+
+void raviX_set_string_interner(struct compiler_state *container, struct string_interner *interner)
+{
+	container->interner = interner;
+}
+
 enum { ALPHABIT = 0, DIGITBIT = 1, PRINTBIT = 2, SPACEBIT = 3, XDIGITBIT = 4 };
 
 #define MASK(B) (1 << (B))
@@ -118,7 +230,6 @@ static inline bool lisxdigit(int c) { return testprop(c, MASK(XDIGITBIT)); }
 */
 static inline int ltolower(int c) { return ((c) | ('A' ^ 'a')); }
 
-#define lua_str2number(s, p) ((lua_Number)strtod((s), (p)))
 static void save(struct lexer_state *ls, int c);
 
 void raviX_token2str(int token, membuff_t *mb)
@@ -135,6 +246,8 @@ void raviX_token2str(int token, membuff_t *mb)
 	}
 }
 
+static void save_span(struct lexer_state *ls, const char *p, size_t len);
+
 static void txtToken(struct lexer_state *ls, int token)
 {
 	switch (token) {
@@ -142,6 +255,36 @@ static void txtToken(struct lexer_state *ls, int token)
 	case TOK_STRING:
 	case TOK_FLT:
 	case TOK_INT:
+		if (raviX_buffer_len(ls->buff) == 0 && ls->span)
+			save_span(ls, ls->span, ls->span_len); /* token was read directly from the source */
+		if (ls->tokens && ls->next_token > 0) {
+			/* the token text is not saved when reading from a token stream, so get it from the source;
+			 * strings are shown with their escapes converted, as the lexer would have saved them */
+			const TokenStream *stream = ls->tokens;
+			uint32_t i = ls->next_token - 1;
+			if (ls->lookahead.token != TOK_EOS && i > 0)
+				i--; /* current token is the one before the look-ahead */
+			const char *text = stream->source + stream->offset[i];
+			raviX_buffer_reset(ls->buff);
+			if (token == TOK_STRING) {
+				const struct string_object *s = stream->seminfo[i].ts;
+				uint32_t sep = 1; /* length of the opening quote or long bracket */
+				if (text[0] == '[') {
+					while (text[sep] == '=')
+						sep++;
+					sep++;
+				}
+				for (uint32_t j = 0; j < sep; j++)
+					save(ls, text[j]);
+				for (uint32_t j = 0; j < s->len; j++)
+					save(ls, s->str[j]);
+				for (uint32_t j = 0; j < sep; j++)
+					save(ls, text[j] == '[' ? ']' : text[j]);
+			} else {
+				for (uint32_t j = 0; j < stream->length[i]; j++)
+					save(ls, text[j]);
+			}
+		}
 		save(ls, '\0');
 		raviX_buffer_add_fstring(&ls->container->error_message, "'%s'", raviX_buffer_data(ls->buff));
 		break;
@@ -164,7 +307,7 @@ void raviX_syntaxerror(struct lexer_state *ls, const char *msg) { lexerror(ls, m
 static void save(struct lexer_state *ls, int c)
 {
 	membuff_t *b = ls->buff;
-	if (raviX_buffer_len(b) + 1 > raviX_buffer_size(b)) {
+	if (raviX_buffer_len(b) + 1 >= raviX_buffer_size(b)) {
 		size_t newsize;
 		if (raviX_buffer_size(b) >= INT_MAX / 2)
 			lexerror(ls, "lexical element too long", 0);
@@ -178,6 +321,18 @@ static void save(struct lexer_state *ls, int c)
 	raviX_buffer_addc(b, c);
 }
 
+/* saves 'len' characters in one go */
+static void save_span(struct lexer_state *ls, const char *p, size_t len)
+{
+	membuff_t *b = ls->buff;
+	if (raviX_buffer_len(b) + len + 1 > raviX_buffer_size(b)) {
+		if (raviX_buffer_len(b) + len >= INT_MAX / 2)
+			lexerror(ls, "lexical element too long", 0);
+		raviX_buffer_reserve(b, len + 1);
+	}
+	raviX_buffer_addbytes(b, p, len);
+}
+
 static inline void save_and_next(struct lexer_state *ls)
 {
 	save(ls, ls->current);
@@ -192,6 +347,66 @@ static const struct string_object *luaX_newstring(struct lexer_state *ls, const
 	return raviX_create_string(ls->container, str, l);
 }
 
+/*
+** creates a new interned string from text in the source buffer, which need not be copied
+** if zero copy strings are enabled
+*/
+static const struct string_object *source_string(struct lexer_state *ls, const char *str, uint32_t l, uint32_t hash)
+{
+	/* blocks of input from a reader are transient so must be copied */
+	return intern_string(ls->container, str, l, hash, ls->container->zero_copy_strings && !ls->reader);
+}
+
+/*
+** remembers the source text of a token that was not saved in buff, for error messages
+*/
+static inline void set_span(struct lexer_state *ls, const char *s, size_t len)
+{
+	if (ls->reader) /* the block of input may be gone by the time the text is needed */
+		save_span(ls, s, len);
+	else {
+		ls->span = s;
+		ls->span_len = len;
+	}
+}
+
+/*
+** Check whether current char is in set 'set' (with two chars) and
+** saves it
+*/
+static int check_next2(struct lexer_state *ls, const char *set)
+{
+	assert(set[2] == '\0');
+	if (ls->current == set[0] || ls->current == set[1]) {
+		save_and_next(ls);
+		return 1;
+	} else
+		return 0;
+}
+
+/* makes room for one more line start, false if out of memory */
+static bool grow_line_table(struct memory_context *memory, struct line_table *lines)
+{
+	if (lines->count < lines->capacity)
+		return true;
+	uint32_t capacity = lines->capacity ? lines->capacity * 2 : 256;
+	uint32_t *starts = (uint32_t *)raviX_try_realloc(memory, lines->starts, capacity * sizeof lines->starts[0]);
+	if (!starts)
+		return false;
+	lines->starts = starts;
+	lines->capacity = capacity;
+	return true;
+}
+
+/* the table starts afresh with line 1 at offset 0 */
+static void reset_line_table(struct memory_context *memory, struct line_table *lines, const char *source)
+{
+	lines->count = 0;
+	lines->source = source;
+	if (grow_line_table(memory, lines))
+		lines->starts[lines->count++] = 0;
+}
+
 /*
 ** increment line number and skips newline sequence (any of
 ** \n, \r, \n\r, or \r\n)
@@ -205,36 +420,115 @@ static void inclinenumber(struct lexer_state *ls)
 		next(ls); /* skip '\n\r' or '\r\n' */
 	if (++ls->linenumber >= INT_MAX)
 		lexerror(ls, "chunk has too many lines", 0);
+	struct line_table *lines = &ls->container->lines;
+	if (!grow_line_table(&ls->container->memory, lines))
+		raviX_out_of_memory(&ls->container->memory);
+	lines->starts[lines->count++] = (uint32_t)current_offset(ls);
 }
 
-struct lexer_state *raviX_init_lexer(struct compiler_state *container, const char *buf, size_t buflen,
-				     const char *source)
+/*
+** Builds the line table for a source that was not lexed by this compiler state
+*/
+static void build_line_table(struct memory_context *memory, struct line_table *lines, const char *s, size_t len)
+{
+	reset_line_table(memory, lines, s);
+	size_t i = 0;
+	for (;;) {
+		i += raviX_scan_newline(s + i, len - i);
+		if (i == len)
+			break;
+		char old = s[i++];
+		if (i < len && (s[i] == '\n' || s[i] == '\r') && s[i] != old)
+			i++; /* '\n\r' or '\r\n' */
+		if (!grow_line_table(memory, lines))
+			break;
+		lines->starts[lines->count++] = (uint32_t)i;
+	}
+}
+
+void raviX_get_line_and_column(const struct compiler_state *container, uint32_t offset, int *line, int *column)
+{
+	const struct line_table *lines = &container->lines;
+	/* find the last line that starts at or before offset */
+	uint32_t lo = 0, hi = lines->count;
+	while (hi - lo > 1) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (lines->starts[mid] <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	*line = (int)lo + 1;
+	*column = (int)(offset - (lines->count ? lines->starts[lo] : 0)) + 1;
+}
+
+/*
+** Called when the current block of input is exhausted, gets the next block from the reader if there is one
+*/
+static int fill(struct lexer_state *z)
 {
-	struct lexer_state *ls = (struct lexer_state *)calloc(1, sizeof(struct lexer_state));
+	z->n = 0;
+	if (z->reader == NULL || z->reader_done)
+		return EOZ;
+	size_t size = 0;
+	const char *block = z->reader(z->reader_data, &size);
+	z->buf_offset += z->bufsize;
+	if (block == NULL || size == 0) {
+		z->reader_done = true;
+		z->buf = z->p = NULL;
+		z->bufsize = 0;
+		return EOZ;
+	}
+	z->buf = z->p = block;
+	z->bufsize = size;
+	z->n = size - 1;
+	return cast_uchar(*z->p++);
+}
+
+static struct lexer_state *init_lexer(struct compiler_state *container, const char *buf, size_t buflen,
+				      raviX_Reader reader, void *reader_data, const char *source)
+{
+	/* interned first so that a failed allocation cannot leave the lexer state behind */
+	const char *envn = raviX_create_string(container, LUA_ENV, (uint32_t)strlen(LUA_ENV))->str; /* get env name */
+	struct lexer_state *ls = (struct lexer_state *)raviX_calloc(&container->memory, 1, sizeof(struct lexer_state));
 	ls->container = container;
 	ls->t.token = 0;
 	ls->buf = buf;
 	ls->bufsize = buflen;
 	ls->n = ls->bufsize;
 	ls->p = ls->buf;
+	ls->reader = reader;
+	ls->reader_data = reader_data;
 	ls->current = zgetc(ls);
 	ls->lookahead.token = TOK_EOS; /* no look-ahead token */
 	ls->linenumber = 1;
 	ls->lastline = 1;
 	ls->source = source;
-	ls->envn = raviX_create_string(ls->container, LUA_ENV, (uint32_t)strlen(LUA_ENV))->str; /* get env name */
+	ls->envn = envn;
 	ls->buff = &container->buff;
-	for (int i = 0; i < NUM_RESERVED; i++) {
-		raviX_create_string(ls->container, luaX_tokens[i], (uint32_t)strlen(luaX_tokens[i]));
-	}
+	assert(ARRAY_SIZE(keyword_strings) == TOK_EOS - FIRST_RESERVED); /* keywords need not be interned */
 	return ls;
 }
 
+struct lexer_state *raviX_init_lexer(struct compiler_state *container, const char *buf, size_t buflen,
+				     const char *source)
+{
+	reset_line_table(&container->memory, &container->lines, buf);
+	return init_lexer(container, buf, buflen, NULL, NULL, source);
+}
+
+struct lexer_state *raviX_init_lexer_with_reader(struct compiler_state *container, raviX_Reader reader,
+						 void *reader_data, const char *source)
+{
+	reset_line_table(&container->memory, &container->lines, NULL);
+	return init_lexer(container, NULL, 0, reader, reader_data, source);
+}
+
 void raviX_destroy_lexer(struct lexer_state *ls)
 {
 	if (ls == NULL)
 		return;
-	free(ls);
+	raviX_free(&ls->container->memory, ls);
 }
 
 const LexState *raviX_get_lexer_info(struct lexer_state *ls) { return (LexState *)ls; }
@@ -263,20 +557,6 @@ static int check_save_next1(struct lexer_state *ls, int c)
 		return 0;
 }
 
-/*
-** Check whether current char is in set 'set' (with two chars) and
-** saves it
-*/
-static int check_next2(struct lexer_state *ls, const char *set)
-{
-	assert(set[2] == '\0');
-	if (ls->current == set[0] || ls->current == set[1]) {
-		save_and_next(ls);
-		return 1;
-	} else
-		return 0;
-}
-
 static int luaO_hexavalue(int c)
 {
 	if (lisdigit(c))
@@ -296,132 +576,23 @@ static int isneg(const char **s)
 }
 
 /*
-** {==================================================================
-** Lua's implementation for 'lua_strx2number'
-** ===================================================================
-*/
-
-#if !defined(lua_strx2number)
-
-/* maximum number of significant digits to read (to avoid overflows
-   even with single floats) */
-#define MAXSIGDIG 30
-
-/*
-** convert an hexadecimal numeric string to a number, following
-** C99 specification for 'strtod'
+** Convert string 's' to a Lua number (put in 'result'). Return NULL
+** on fail or the address of the ending '\0' on success.
+** The conversion is done by 'raviX_str2d', which is correctly rounded
+** and does not depend on the locale; 'inf' and 'nan' are rejected.
 */
-static lua_Number lua_strx2number(const char *s, char **endptr)
-{
-	int dot = lua_getlocaledecpoint();
-	lua_Number r = 0.0;  /* result (accumulator) */
-	int sigdig = 0;	     /* number of significant digits */
-	int nosigdig = 0;    /* number of non-significant digits */
-	int e = 0;	     /* exponent correction */
-	int neg;	     /* 1 if number is negative */
-	int hasdot = 0;	     /* true after seen a dot */
-	*endptr = (char *)s; /* nothing is valid yet */
-	while (lisspace(cast_uchar(*s)))
-		s++;						  /* skip initial spaces */
-	neg = isneg(&s);					  /* check signal */
-	if (!(*s == '0' && (*(s + 1) == 'x' || *(s + 1) == 'X'))) /* check '0x' */
-		return 0.0;					  /* invalid format (no '0x') */
-	for (s += 2;; s++) {					  /* skip '0x' and read numeral */
-		if (*s == dot) {
-			if (hasdot)
-				break; /* second dot? stop loop */
-			else
-				hasdot = 1;
-		} else if (lisxdigit(cast_uchar(*s))) {
-			if (sigdig == 0 && *s == '0') /* non-significant digit (zero)? */
-				nosigdig++;
-			else if (++sigdig <= MAXSIGDIG) /* can read it without overflow? */
-				r = (r * cast_num(16.0)) + luaO_hexavalue(*s);
-			else
-				e++; /* too many digits; ignore, but still count for exponent */
-			if (hasdot)
-				e--; /* decimal digit? correct exponent */
-		} else
-			break; /* neither a dot nor a digit */
-	}
-	if (nosigdig + sigdig == 0)   /* no digits? */
-		return 0.0;	      /* invalid format */
-	*endptr = (char *)s;	      /* valid up to here */
-	e *= 4;			      /* each digit multiplies/divides value by 2^4 */
-	if (*s == 'p' || *s == 'P') { /* exponent part? */
-		int exp1 = 0;	      /* exponent value */
-		int neg1;	      /* exponent signal */
-		s++;		      /* skip 'p' */
-		neg1 = isneg(&s);     /* signal */
-		if (!lisdigit(cast_uchar(*s)))
-			return 0.0;		 /* invalid; must have at least one digit */
-		while (lisdigit(cast_uchar(*s))) /* read exponent */
-			exp1 = exp1 * 10 + *(s++) - '0';
-		if (neg1)
-			exp1 = -exp1;
-		e += exp1;
-		*endptr = (char *)s; /* valid up to here */
-	}
-	if (neg)
-		r = -r;
-	return (lua_Number)ldexp(r, e);
-}
-
-#endif
-/* }====================================================== */
-
-/* maximum length of a numeral */
-#if !defined(L_MAXLENNUM)
-#define L_MAXLENNUM 200
-#endif
-
-static const char *l_str2dloc(const char *s, lua_Number *result, int mode)
+static const char *l_str2d(const char *s, lua_Number *result)
 {
-	char *endptr;
-	*result = (mode == 'x') ? lua_strx2number(s, &endptr) /* try to convert */
-				: lua_str2number(s, &endptr);
-	if (endptr == s)
+	while (lisspace(cast_uchar(*s)))
+		s++; /* skip initial spaces */
+	const char *endptr = raviX_str2d(s, result);
+	if (endptr == NULL)
 		return NULL; /* nothing recognized? */
 	while (lisspace(cast_uchar(*endptr)))
 		endptr++;			  /* skip trailing spaces */
 	return (*endptr == '\0') ? endptr : NULL; /* OK if no trailing characters */
 }
 
-/*
-** Convert string 's' to a Lua number (put in 'result'). Return NULL
-** on fail or the address of the ending '\0' on success.
-** 'pmode' points to (and 'mode' contains) special things in the string:
-** - 'x'/'X' means an hexadecimal numeral
-** - 'n'/'N' means 'inf' or 'nan' (which should be rejected)
-** - '.' just optimizes the search for the common case (nothing special)
-** This function accepts both the current locale or a dot as the radix
-** mark. If the convertion fails, it may mean number has a dot but
-** locale accepts something else. In that case, the code copies 's'
-** to a buffer (because 's' is read-only), changes the dot to the
-** current locale radix mark, and tries to convert again.
-*/
-static const char *l_str2d(const char *s, lua_Number *result)
-{
-	const char *endptr;
-	const char *pmode = strpbrk(s, ".xXnN");
-	int mode = pmode ? ltolower(cast_uchar(*pmode)) : 0;
-	if (mode == 'n') /* reject 'inf' and 'nan' */
-		return NULL;
-	endptr = l_str2dloc(s, result, mode); /* try to convert */
-	if (endptr == NULL) {		      /* failed? may be a different locale */
-		char buff[L_MAXLENNUM + 1];
-		const char *pdot = strchr(s, '.');
-		if (strlen(s) > L_MAXLENNUM || pdot == NULL)
-			return NULL;			  /* string too long or no dot; fail */
-		strcpy(buff, s);			  /* copy string to buffer */
-		buff[pdot - s] = lua_getlocaledecpoint(); /* correct decimal point */
-		endptr = l_str2dloc(buff, result, mode);  /* try again */
-		if (endptr != NULL)
-			endptr = s + (endptr - buff); /* make relative to 's' */
-	}
-	return endptr;
-}
-
 #define MAXBY10 cast(lua_Unsigned, LUA_MAXINTEGER / 10)
 #define MAXLASTD cast_int(LUA_MAXINTEGER % 10)
 
@@ -491,20 +662,41 @@ static int read_numeral(struct lexer_state *ls, SemInfo *seminfo)
 {
 	struct konst obj;
 	const char *expo = "Ee";
-	int first = ls->current;
 	assert(lisdigit(ls->current));
-	save_and_next(ls);
-	if (first == '0' && check_next2(ls, "xX")) /* hexadecimal? */
-		expo = "Pp";
-	for (;;) {
-		if (check_next2(ls, expo))     /* exponent part? */
-			check_next2(ls, "-+"); /* optional exponent sign */
-		if (lisxdigit(ls->current))
-			save_and_next(ls);
-		else if (ls->current == '.')
-			save_and_next(ls);
-		else
-			break;
+	if (ls->reader) { /* numeral may span blocks of input, so read one character at a time */
+		int first = ls->current;
+		save_and_next(ls);
+		if (first == '0' && check_next2(ls, "xX")) /* hexadecimal? */
+			expo = "Pp";
+		for (;;) {
+			if (check_next2(ls, expo))     /* exponent part? */
+				check_next2(ls, "-+"); /* optional exponent sign */
+			if (lisxdigit(ls->current) || ls->current == '.')
+				save_and_next(ls);
+			else
+				break;
+		}
+	} else { /* numeral is scanned in the source and then copied */
+		const char *s = ls->p - 1;
+		size_t n = available(ls);
+		size_t i = 1;
+		if (s[0] == '0' && i < n && (s[i] == 'x' || s[i] == 'X')) { /* hexadecimal? */
+			expo = "Pp";
+			i++;
+		}
+		for (;;) {
+			if (i < n && (s[i] == expo[0] || s[i] == expo[1])) { /* exponent part? */
+				i++;
+				if (i < n && (s[i] == '-' || s[i] == '+')) /* optional exponent sign */
+					i++;
+			}
+			if (i < n && (lisxdigit(cast_uchar(s[i])) || s[i] == '.'))
+				i++;
+			else
+				break;
+		}
+		save_span(ls, s, i);
+		skip(ls, i);
 	}
 	save(ls, '\0');
 	if (luaO_str2num(raviX_buffer_data(ls->buff), &obj) == 0) /* format error? */
@@ -544,6 +736,9 @@ static void read_long_string(struct lexer_state *ls, SemInfo *seminfo, int sep)
 	save_and_next(ls);	   /* skip 2nd '[' */
 	if (currIsNewline(ls))	   /* string starts with a newline? */
 		inclinenumber(ls); /* skip it */
+	bool verbatim = !ls->reader; /* false if contents differ from the source due to conversion of line breaks */
+	/* start of contents in the source; a reader may have run out of input, leaving no pointer to go back from */
+	const char *start = verbatim ? ls->p - 1 : NULL;
 	for (;;) {
 		switch (ls->current) {
 		case EOZ: { /* error */
@@ -564,24 +759,32 @@ static void read_long_string(struct lexer_state *ls, SemInfo *seminfo, int sep)
 		}
 		case '\n':
 		case '\r': {
-			save(ls, '\n');
+			if (seminfo)
+				save(ls, '\n');
+			if (ls->current == '\r' || (available(ls) > 1 && ls->p[0] == '\r'))
+				verbatim = false; /* '\r' is not kept */
 			inclinenumber(ls);
 			if (!seminfo)
 				raviX_buffer_reset(ls->buff); /* avoid wasting space */
 			break;
 		}
 		default: {
+			size_t count = raviX_scan_long_string(ls->p - 1, available(ls)); /* up to next ']' or newline */
 			if (seminfo)
-				save_and_next(ls);
-			else
-				next(ls);
+				save_span(ls, ls->p - 1, count);
+			skip(ls, count);
 		}
 		}
 	}
 endloop:
-	if (seminfo)
-		seminfo->ts = luaX_newstring(ls, raviX_buffer_data(ls->buff) + (2 + sep),
-					     (uint32_t)(raviX_buffer_len(ls->buff) - 2 * (2 + sep)));
+	if (seminfo) {
+		const char *s = raviX_buffer_data(ls->buff) + (2 + sep);
+		uint32_t len = (uint32_t)(raviX_buffer_len(ls->buff) - 2 * (2 + sep));
+		if (verbatim)
+			seminfo->ts = source_string(ls, start, len, raviX_hash_data(s, len));
+		else
+			seminfo->ts = luaX_newstring(ls, s, len);
+	}
 }
 
 static void esccheck(struct lexer_state *ls, int c, const char *msg)
@@ -648,7 +851,18 @@ static int readdecesc(struct lexer_state *ls)
 
 static void read_string(struct lexer_state *ls, int del, SemInfo *seminfo)
 {
-	save_and_next(ls); /* keep delimiter (for error messages) */
+	const char *s = ls->p - 1;
+	size_t n = available(ls);
+	size_t len = 1 + raviX_scan_short_string(s + 1, n - 1, del);
+	if (len < n && s[len] == del) {
+		/* no escapes, so the string is interned directly from the source */
+		seminfo->ts = source_string(ls, s + 1, (uint32_t)(len - 1), raviX_hash_data(s + 1, len - 1));
+		set_span(ls, s, len + 1);
+		skip(ls, len + 1);
+		return;
+	}
+	save_span(ls, s, len); /* keep delimiter (for error messages) */
+	skip(ls, len);
 	while (ls->current != del) {
 		switch (ls->current) {
 		case EOZ:
@@ -727,8 +941,11 @@ static void read_string(struct lexer_state *ls, int del, SemInfo *seminfo)
 		no_save:
 			break;
 		}
-		default:
-			save_and_next(ls);
+		default: {
+			size_t count = raviX_scan_short_string(ls->p - 1, available(ls), del);
+			save_span(ls, ls->p - 1, count);
+			skip(ls, count);
+		}
 		}
 	}
 	save_and_next(ls); /* skip delimiter */
@@ -745,8 +962,11 @@ static int casttoken(struct lexer_state *ls, SemInfo *seminfo)
 	const char *s = raviX_buffer_data(ls->buff);
 	int tok;
 
-	/* @integer or @integer[] */
-	if (strncmp(s, "@integer", n) == 0)
+	int keyword = find_keyword(s, n);
+	if (keyword >= 0) /* exact match, must be one of the @type tokens */
+		tok = keyword + FIRST_RESERVED;
+	/* otherwise match a prefix as before: @integer or @integer[] */
+	else if (strncmp(s, "@integer", n) == 0)
 		tok = TOK_TO_INTEGER;
 	else if (strncmp(s, "@integer[]", n) == 0)
 		tok = TOK_TO_INTARRAY;
@@ -773,7 +993,10 @@ static int casttoken(struct lexer_state *ls, SemInfo *seminfo)
 static int llex(struct lexer_state *ls, SemInfo *seminfo)
 {
 	raviX_buffer_reset(ls->buff);
+	ls->span = NULL;
 	for (;;) {
+		ls->token_offset = current_offset(ls);
+		ls->token_line = ls->linenumber;
 		switch (ls->current) {
 		case '\n':
 		case '\r': { /* line breaks */
@@ -784,7 +1007,7 @@ static int llex(struct lexer_state *ls, SemInfo *seminfo)
 		case '\f':
 		case '\t':
 		case '\v': { /* spaces */
-			next(ls);
+			skip(ls, raviX_scan_spaces(ls->p - 1, available(ls)));
 			break;
 		}
 		case '-': { /* '-' or '--' (comment) */
@@ -802,9 +1025,9 @@ static int llex(struct lexer_state *ls, SemInfo *seminfo)
 					break;
 				}
 			}
-			/* else short comment */
+			/* else short comment, skip until end of line (or end of file) */
 			while (!currIsNewline(ls) && ls->current != EOZ)
-				next(ls); /* skip until end of line (or end of file) */
+				skip(ls, raviX_scan_newline(ls->p - 1, available(ls)));
 			break;
 		}
 		case '[': { /* long string or simply '[' */
@@ -906,12 +1129,37 @@ static int llex(struct lexer_state *ls, SemInfo *seminfo)
 		}
 		default: {
 			if (lislalpha(ls->current)) { /* identifier or reserved word? */
+				const char *s = ls->p - 1;
+				size_t n = available(ls);
+				size_t len = 1;
+#if defined(RAVICOMP_FNV_HASH)
+				/* scan the identifier in the source, hashing as we go */
+				uint32_t hash = fnv1_hash_byte(FNV1_HASH_SEED, cast_uchar(s[0]));
+				while (len < n && lislalnum(cast_uchar(s[len]))) {
+					hash = fnv1_hash_byte(hash, cast_uchar(s[len]));
+					len++;
+				}
+#else
+				/* scan the identifier in the source, then hash it a word at a time */
+				while (len < n && lislalnum(cast_uchar(s[len])))
+					len++;
+				uint32_t hash = raviX_hash_data(s, len);
+#endif
+				if (len >= INT_MAX / 2)
+					lexerror(ls, "lexical element too long", 0);
 				const struct string_object *ts;
-				do {
-					save_and_next(ls);
-				} while (lislalnum(ls->current));
-				ts = raviX_create_string(ls->container, raviX_buffer_data(ls->buff),
-							 (int32_t)raviX_buffer_len(ls->buff));
+				if (len < n || !ls->reader) {
+					ts = source_string(ls, s, (uint32_t)len, hash);
+					set_span(ls, s, len);
+					skip(ls, len);
+				} else {
+					/* name may continue in the next block of input */
+					save_span(ls, s, len);
+					skip(ls, len);
+					while (lislalnum(ls->current))
+						save_and_next(ls);
+					ts = luaX_newstring(ls, raviX_buffer_data(ls->buff), (uint32_t)raviX_buffer_len(ls->buff));
+				}
 				seminfo->ts = ts;
 				int tok = is_reserved(ts);
 				if (tok != -1) /* reserved word? */
@@ -929,21 +1177,758 @@ static int llex(struct lexer_state *ls, SemInfo *seminfo)
 	}
 }
 
+/*
+** Counts the line breaks in a token, using the same rules as inclinenumber()
+*/
+static int count_newlines(const char *s, size_t len)
+{
+	int count = 0;
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] == '\n' || s[i] == '\r') {
+			if (i + 1 < len && (s[i + 1] == '\n' || s[i + 1] == '\r') && s[i + 1] != s[i])
+				i++; /* skip '\n\r' or '\r\n' */
+			count++;
+		}
+	}
+	return count;
+}
+
+/*
+** Reads the next token from the token stream; the line number is updated
+** to be where llex() would have left it, i.e. the line where the token ends.
+*/
+static int read_token(struct lexer_state *ls, SemInfo *seminfo)
+{
+	const TokenStream *stream = ls->tokens;
+	uint32_t i = ls->next_token;
+	assert(i < stream->count);
+	int token = stream->token[i];
+	*seminfo = stream->seminfo[i];
+	ls->token_offset = stream->offset[i];
+	ls->linenumber = stream->line[i];
+	if (token == TOK_STRING) /* only strings can span lines */
+		ls->linenumber += count_newlines(stream->source + stream->offset[i], stream->length[i]);
+	if (token != TOK_EOS)
+		ls->next_token++;
+	return token;
+}
+
+static inline int next_token(struct lexer_state *ls, SemInfo *seminfo)
+{
+	return ls->tokens ? read_token(ls, seminfo) : llex(ls, seminfo);
+}
+
 void raviX_next(struct lexer_state *ls)
 {
 	ls->lastline = ls->linenumber;
+	ls->lastoffset = ls->t.offset;
 	if (ls->lookahead.token != TOK_EOS) {  /* is there a look-ahead token? */
 		ls->t = ls->lookahead;	       /* use this one */
 		ls->lookahead.token = TOK_EOS; /* and discharge it */
-	} else
-		ls->t.token = llex(ls, &ls->t.seminfo); /* read next token */
+	} else {
+		ls->t.token = next_token(ls, &ls->t.seminfo); /* read next token */
+		ls->t.offset = (uint32_t)ls->token_offset;
+	}
 }
 
 int raviX_lookahead(struct lexer_state *ls)
 {
 	assert(ls->lookahead.token == TOK_EOS);
-	ls->lookahead.token = llex(ls, &ls->lookahead.seminfo);
+	ls->lookahead.token = next_token(ls, &ls->lookahead.seminfo);
+	ls->lookahead.offset = (uint32_t)ls->token_offset;
 	return ls->lookahead.token;
 }
 
-const char *raviX_get_last_error(struct compiler_state *container) { return container->error_message.buf; }
+struct lexer_state *raviX_init_token_stream_lexer(struct compiler_state *container, const TokenStream *stream,
+						  const char *source)
+{
+	assert(stream->count > 0 && stream->token[stream->count - 1] == TOK_EOS);
+	size_t len = stream->offset[stream->count - 1];
+	if (container->lines.source != stream->source || container->lines.count == 0)
+		build_line_table(&container->memory, &container->lines, stream->source,
+				 len); /* stream was lexed elsewhere */
+	struct lexer_state *ls = init_lexer(container, stream->source, len, NULL, NULL, source);
+	ls->tokens = stream;
+	ls->next_token = 0;
+	return ls;
+}
+
+/*
+** Makes sure there is space for at least one more token in the stream. The arrays of a stream
+** always come from the hooks of the compiler state that first allocated them.
+*/
+static bool resize_token_stream(struct compiler_state *container, TokenStream *stream, uint32_t capacity)
+{
+	if (!stream->allocator.realloc)
+		stream->allocator = container->memory.hooks;
+	container->memory.bytes_requested += (uint64_t)capacity * (sizeof stream->token[0] + sizeof stream->offset[0] +
+								  sizeof stream->length[0] + sizeof stream->line[0] +
+								  sizeof stream->seminfo[0]);
+	void *ud = stream->allocator.user_data;
+	uint16_t *token = (uint16_t *)stream->allocator.realloc(ud, stream->token, capacity * sizeof stream->token[0]);
+	if (token)
+		stream->token = token;
+	uint32_t *offset =
+	    (uint32_t *)stream->allocator.realloc(ud, stream->offset, capacity * sizeof stream->offset[0]);
+	if (offset)
+		stream->offset = offset;
+	uint32_t *length =
+	    (uint32_t *)stream->allocator.realloc(ud, stream->length, capacity * sizeof stream->length[0]);
+	if (length)
+		stream->length = length;
+	int *line = (int *)stream->allocator.realloc(ud, stream->line, capacity * sizeof stream->line[0]);
+	if (line)
+		stream->line = line;
+	SemInfo *seminfo =
+	    (SemInfo *)stream->allocator.realloc(ud, stream->seminfo, capacity * sizeof stream->seminfo[0]);
+	if (seminfo)
+		stream->seminfo = seminfo;
+	if (!token || !offset || !length || !line || !seminfo)
+		return false;
+	stream->capacity = capacity;
+	return true;
+}
+
+static void grow_token_stream(struct lexer_state *ls, TokenStream *stream)
+{
+	if (stream->count < stream->capacity)
+		return;
+	uint32_t capacity = stream->capacity ? stream->capacity * 2 : (uint32_t)(ls->bufsize / 4 + 16);
+	if (!resize_token_stream(ls->container, stream, capacity))
+		raviX_out_of_memory(&ls->container->memory);
+}
+
+/* Reads the next token and appends it to the stream */
+static int lex_token(struct lexer_state *ls, TokenStream *stream)
+{
+	grow_token_stream(ls, stream);
+	uint32_t i = stream->count;
+	stream->seminfo[i].i = 0;
+	int token = llex(ls, &stream->seminfo[i]);
+	stream->token[i] = (uint16_t)token;
+	stream->offset[i] = (uint32_t)ls->token_offset;
+	stream->length[i] = (uint32_t)(current_offset(ls) - ls->token_offset);
+	stream->line[i] = ls->token_line;
+	stream->count = i + 1;
+	return token;
+}
+
+static int lex_all(struct compiler_state *container, const char *buf, size_t buflen, const char *source_name,
+		   TokenStream *stream)
+{
+	stream->count = 0;
+	stream->source = buf;
+	if (buflen >= UINT32_MAX) {
+		raviX_buffer_add_fstring(&container->error_message, "%s: input too large", source_name);
+		return 1;
+	}
+	struct lexer_state *volatile ls = NULL;
+	raviX_catch_memory_errors(container);
+	int rc = setjmp(container->env);
+	if (rc == 0) {
+		ls = raviX_init_lexer(container, buf, buflen, source_name);
+		while (lex_token(ls, stream) != TOK_EOS)
+			;
+	}
+	raviX_end_memory_errors(container);
+	raviX_destroy_lexer(ls);
+	return rc;
+}
+
+int raviX_lex_all(struct compiler_state *container, const char *buf, size_t buflen, const char *source_name,
+		  TokenStream *stream)
+{
+	struct phase_timer timer;
+	raviX_begin_phase(container, &timer);
+	int rc = lex_all(container, buf, buflen, source_name, stream);
+	raviX_end_phase(container, COMPILER_PHASE_LEX, &timer);
+	return rc;
+}
+
+/*
+** Replaces the line starts after line 'line' with those recorded while re-lexing, followed by the
+** old ones after 'old_end' moved by 'delta'
+*/
+static bool splice_line_table(struct memory_context *memory, struct line_table *lines, int line,
+			      const struct line_table *relexed, size_t old_end, ptrdiff_t delta)
+{
+	uint32_t tail = lines->count;
+	while (tail > (uint32_t)line && lines->starts[tail - 1] > old_end)
+		tail--;
+	uint32_t kept = lines->count - tail;
+	uint32_t count = (uint32_t)line + relexed->count + kept;
+	if (count > lines->capacity) {
+		uint32_t *starts = (uint32_t *)raviX_try_realloc(memory, lines->starts, count * sizeof lines->starts[0]);
+		if (!starts)
+			return false;
+		lines->starts = starts;
+		lines->capacity = count;
+	}
+	uint32_t *dest = lines->starts + line + relexed->count;
+	memmove(dest, lines->starts + tail, kept * sizeof lines->starts[0]);
+	for (uint32_t i = 0; i < kept; i++)
+		dest[i] = (uint32_t)(dest[i] + delta);
+	if (relexed->count)
+		memcpy(lines->starts + line, relexed->starts, relexed->count * sizeof lines->starts[0]);
+	lines->count = count;
+	return true;
+}
+
+/*
+** Finds the token to restart lexing at: the last one that ends before the edit - the lexer also
+** looks at the character following a token, which is why that must be before the edit too.
+** Every token start is a safe place to restart, as the lexer carries no state across tokens
+** apart from the line number. Returns 0 if there is no such token.
+*/
+static uint32_t relex_start(const TokenStream *stream, size_t edit_offset)
+{
+	uint32_t lo = 0, hi = stream->count;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if ((size_t)stream->offset[mid] + stream->length[mid] < edit_offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo ? lo - 1 : 0;
+}
+
+/*
+** Lexes the edited input from the start of token 'first' until a new token lines up with an old
+** one after the edit, as from there on the source is unchanged and so are the old tokens. On return
+** 'sync' is the index of the old token that matches the last new one, or the token count if none does.
+*/
+static int relex_tokens(struct compiler_state *container, const TokenStream *stream, const char *buf,
+			size_t buflen, uint32_t first, size_t edit_offset, size_t removed, size_t inserted,
+			const char *source_name, TokenStream *relexed, uint32_t *sync)
+{
+	size_t restart = first ? stream->offset[first] : 0;
+	struct lexer_state *volatile ls = NULL;
+	*sync = first;
+	raviX_catch_memory_errors(container);
+	int rc = setjmp(container->env);
+	if (rc == 0) {
+		ls = init_lexer(container, buf + restart, buflen - restart, NULL, NULL, source_name);
+		ls->buf_offset = restart;
+		ls->linenumber = first ? stream->line[first] : 1;
+		for (;;) {
+			int token = lex_token(ls, relexed);
+			size_t offset = relexed->offset[relexed->count - 1];
+			if (offset >= edit_offset + inserted) {
+				size_t old_offset = offset - inserted + removed;
+				while (*sync < stream->count && stream->offset[*sync] < old_offset)
+					(*sync)++;
+				if (*sync < stream->count && stream->offset[*sync] == old_offset)
+					break;
+			}
+			if (token == TOK_EOS) {
+				*sync = stream->count;
+				break;
+			}
+		}
+	}
+	raviX_end_memory_errors(container);
+	raviX_destroy_lexer(ls);
+	return rc;
+}
+
+static int relex(struct compiler_state *container, TokenStream *stream, const char *buf, size_t buflen,
+		 size_t edit_offset, size_t removed, size_t inserted, const char *source_name)
+{
+	assert(stream->count > 0 && stream->token[stream->count - 1] == TOK_EOS);
+	assert(edit_offset + removed <= stream->offset[stream->count - 1]);
+	assert(buflen == stream->offset[stream->count - 1] - removed + inserted);
+	if (buflen >= UINT32_MAX) {
+		raviX_buffer_add_fstring(&container->error_message, "%s: input too large", source_name);
+		return 1;
+	}
+	uint32_t first = relex_start(stream, edit_offset); /* first token to be replaced */
+	int line = first ? stream->line[first] : 1;
+
+	/* line starts found while re-lexing go in a separate table that is spliced in afterwards */
+	struct line_table lines = container->lines;
+	memset(&container->lines, 0, sizeof container->lines);
+	TokenStream relexed;
+	memset(&relexed, 0, sizeof relexed);
+	uint32_t sync = first;
+	int rc = relex_tokens(container, stream, buf, buflen, first, edit_offset, removed, inserted, source_name,
+			      &relexed, &sync);
+	struct line_table relexed_lines = container->lines;
+	container->lines = lines;
+	bool synced = sync < stream->count;
+	if (rc == 0) {
+		uint32_t tail = synced ? sync + 1 : stream->count; /* first old token that is kept */
+		uint32_t kept = stream->count - tail;
+		uint32_t count = first + relexed.count + kept;
+		ptrdiff_t delta = (ptrdiff_t)inserted - (ptrdiff_t)removed;
+		int line_delta = synced ? relexed.line[relexed.count - 1] - stream->line[sync] : 0;
+		size_t old_end = synced ? (size_t)stream->offset[sync] + stream->length[sync] : SIZE_MAX;
+		if (count > stream->capacity && !resize_token_stream(container, stream, count)) {
+			container->memory.failed = true;
+			rc = 1;
+		} else {
+			uint32_t dest = first + relexed.count;
+			if (dest != tail) {
+				memmove(stream->token + dest, stream->token + tail, kept * sizeof stream->token[0]);
+				memmove(stream->offset + dest, stream->offset + tail, kept * sizeof stream->offset[0]);
+				memmove(stream->length + dest, stream->length + tail, kept * sizeof stream->length[0]);
+				memmove(stream->line + dest, stream->line + tail, kept * sizeof stream->line[0]);
+				memmove(stream->seminfo + dest, stream->seminfo + tail, kept * sizeof stream->seminfo[0]);
+			}
+			for (uint32_t i = dest; i < count; i++) {
+				stream->offset[i] = (uint32_t)(stream->offset[i] + delta);
+				stream->line[i] += line_delta;
+			}
+			memcpy(stream->token + first, relexed.token, relexed.count * sizeof stream->token[0]);
+			memcpy(stream->offset + first, relexed.offset, relexed.count * sizeof stream->offset[0]);
+			memcpy(stream->length + first, relexed.length, relexed.count * sizeof stream->length[0]);
+			memcpy(stream->line + first, relexed.line, relexed.count * sizeof stream->line[0]);
+			memcpy(stream->seminfo + first, relexed.seminfo, relexed.count * sizeof stream->seminfo[0]);
+			stream->count = count;
+			bool patched = container->lines.source == stream->source &&
+				       container->lines.count >= (uint32_t)line &&
+				       splice_line_table(&container->memory, &container->lines, line, &relexed_lines,
+							 old_end, delta);
+			stream->source = buf;
+			if (patched)
+				container->lines.source = buf;
+			else
+				build_line_table(&container->memory, &container->lines, buf, buflen);
+		}
+	}
+	raviX_free(&container->memory, relexed_lines.starts);
+	raviX_destroy_token_stream(&relexed);
+	return rc;
+}
+
+int raviX_relex(struct compiler_state *container, TokenStream *stream, const char *buf, size_t buflen,
+		size_t edit_offset, size_t removed, size_t inserted, const char *source_name)
+{
+	struct phase_timer timer;
+	raviX_begin_phase(container, &timer);
+	int rc = relex(container, stream, buf, buflen, edit_offset, removed, inserted, source_name);
+	raviX_end_phase(container, COMPILER_PHASE_LEX, &timer);
+	return rc;
+}
+
+/*
+** Parallel lexing. The input is split into slices that start at line breaks where possible, and
+** each slice is tokenized on a worker thread assuming that its start is a token boundary, i.e. not
+** inside a string or comment. The slices are then walked in order: when a slice holds a token at
+** the offset where the previous slice stopped, its tokens from there on are correct as the lexer
+** carries no state across tokens apart from the line number, which is adjusted. Otherwise the
+** speculation was wrong and the main thread lexes from that offset until it agrees with the slice
+** again, or reaches its end. Workers intern strings in their own compiler state; the strings of the
+** tokens kept are moved to the main compiler state once the slices are reconciled, unless the
+** strings go to a shared interner anyway.
+*/
+
+enum { MIN_SLICE_SIZE = 256 * 1024 }; /* default lower limit, smaller slices are not worth a thread */
+
+/* A slice of the input tokenized by a worker */
+struct lex_slice {
+	size_t start, end;  /* tokens starting in [start, end) belong to the slice */
+	TokenStream tokens; /* tokens found assuming 'start' is a token boundary, lines counted from 1 at 'start' */
+	size_t stop;	    /* offset of the first token at or after 'end', or of the token that failed */
+	int stop_line;	    /* line of that token */
+	bool failed;	    /* lexing failed before reaching 'end' */
+};
+
+struct lex_worker {
+	struct compiler_state *container; /* holds the strings interned by the worker */
+	struct parallel_lexer *pl;
+	unsigned index; /* the worker lexes slices index, index + nworkers, ... */
+	raviX_thread thread;
+	bool started;
+};
+
+/* A run of tokens that ends up in the output */
+struct lex_piece {
+	const TokenStream *tokens;
+	uint32_t first, count;
+	uint32_t out; /* index of the first token in the output */
+	int line_delta;
+	struct lex_worker *worker; /* owner of the strings referenced by the tokens, NULL for the main thread */
+};
+
+struct parallel_lexer {
+	struct compiler_state *container;
+	const char *buf;
+	size_t buflen;
+	const char *source_name;
+	struct lex_slice *slices;
+	unsigned nslices;
+	struct lex_worker *workers;
+	unsigned nworkers;
+	TokenStream relexed;	/* tokens lexed by the main thread */
+	struct lexer_state *ls; /* lexer in use on the main thread */
+	struct lex_piece *pieces;
+	unsigned npieces;
+	TokenStream *stream;
+};
+
+static void lex_slice(struct lex_worker *worker, struct lex_slice *slice)
+{
+	struct parallel_lexer *pl = worker->pl;
+	struct compiler_state *container = worker->container;
+	struct lexer_state *volatile ls = NULL;
+	raviX_catch_memory_errors(container);
+	if (setjmp(container->env) == 0) {
+		ls = init_lexer(container, pl->buf + slice->start, pl->buflen - slice->start, NULL, NULL,
+				pl->source_name);
+		ls->buf_offset = slice->start;
+		for (;;) {
+			int token = lex_token(ls, &slice->tokens);
+			if (ls->token_offset >= slice->end) {
+				slice->tokens.count--;
+				break;
+			}
+			if (token == TOK_EOS)
+				break;
+		}
+	} else {
+		slice->failed = true;
+	}
+	raviX_end_memory_errors(container);
+	if (!ls) {
+		/* out of memory before lexing started, the main thread lexes the whole slice */
+		slice->stop = slice->start;
+		slice->stop_line = 1;
+		return;
+	}
+	slice->stop = ls->token_offset;
+	slice->stop_line = ls->token_line;
+	raviX_destroy_lexer(ls);
+}
+
+static void lex_slices(void *arg)
+{
+	struct lex_worker *worker = (struct lex_worker *)arg;
+	struct parallel_lexer *pl = worker->pl;
+	for (unsigned i = worker->index; i < pl->nslices; i += pl->nworkers)
+		lex_slice(worker, &pl->slices[i]);
+}
+
+static void add_piece(struct parallel_lexer *pl, const TokenStream *tokens, uint32_t first, uint32_t count,
+		      int line_delta, struct lex_worker *worker)
+{
+	if (count == 0)
+		return;
+	/* each slice adds at most three pieces */
+	struct lex_piece *piece = &pl->pieces[pl->npieces++];
+	piece->tokens = tokens;
+	piece->first = first;
+	piece->count = count;
+	piece->line_delta = line_delta;
+	piece->worker = worker;
+}
+
+/*
+** Lexes on the main thread from 'pos' until reaching the end of the slice or a token that the
+** slice has too, looking for it from index 'j'. On return 'pos' and 'line' give the token
+** that stopped lexing, and the index of that token in the slice is returned if it has it.
+*/
+static uint32_t lex_until_agreed(struct parallel_lexer *pl, struct lex_slice *slice, size_t *pos, int *line,
+				 uint32_t j)
+{
+	const TokenStream *spec = &slice->tokens;
+	TokenStream *relexed = &pl->relexed;
+	uint32_t first = relexed->count;
+	pl->ls = init_lexer(pl->container, pl->buf + *pos, pl->buflen - *pos, NULL, NULL, pl->source_name);
+	pl->ls->buf_offset = *pos;
+	pl->ls->linenumber = *line;
+	for (;;) {
+		int token = lex_token(pl->ls, relexed);
+		uint32_t i = relexed->count - 1;
+		size_t offset = relexed->offset[i];
+		while (j < spec->count && spec->offset[j] < offset)
+			j++;
+		if (offset >= slice->end || (j < spec->count && spec->offset[j] == offset)) {
+			relexed->count = i;
+			*pos = offset;
+			*line = relexed->line[i];
+			break;
+		}
+		if (token == TOK_EOS) {
+			*pos = pl->buflen + 1;
+			break;
+		}
+	}
+	raviX_destroy_lexer(pl->ls);
+	pl->ls = NULL;
+	add_piece(pl, relexed, first, relexed->count - first, 0, NULL);
+	return j;
+}
+
+/* Picks the tokens of the slice that start at or after 'pos', the offset of the next token */
+static void reconcile_slice(struct parallel_lexer *pl, struct lex_slice *slice, struct lex_worker *worker,
+			    size_t *pos, int *line)
+{
+	const TokenStream *spec = &slice->tokens;
+	if (*pos >= slice->end)
+		return; /* covered by a token that started in an earlier slice */
+	uint32_t j = 0;
+	int line_delta = *line - 1;
+	if (*pos != slice->start) {
+		uint32_t hi = spec->count;
+		while (j < hi) {
+			uint32_t mid = j + (hi - j) / 2;
+			if (spec->offset[mid] < *pos)
+				j = mid + 1;
+			else
+				hi = mid;
+		}
+		if (j == spec->count || spec->offset[j] != *pos) {
+			j = lex_until_agreed(pl, slice, pos, line, j);
+			if (*pos >= slice->end)
+				return;
+		}
+		line_delta = *line - spec->line[j];
+	}
+	add_piece(pl, spec, j, spec->count - j, line_delta, worker);
+	*pos = slice->stop;
+	*line = slice->stop_line + line_delta;
+	if (slice->failed)
+		lex_until_agreed(pl, slice, pos, line, spec->count);
+}
+
+static void reconcile_slices(struct parallel_lexer *pl)
+{
+	size_t pos = 0;
+	int line = 1;
+	for (unsigned i = 0; i < pl->nslices; i++)
+		reconcile_slice(pl, &pl->slices[i], &pl->workers[i % pl->nworkers], &pos, &line);
+}
+
+/* Copies the pieces that reference strings owned by the worker to the output, or those lexed on the main thread */
+static void copy_pieces(struct parallel_lexer *pl, struct lex_worker *worker)
+{
+	TokenStream *stream = pl->stream;
+	const struct string_set *strings = &pl->container->strings;
+	for (unsigned p = 0; p < pl->npieces; p++) {
+		const struct lex_piece *piece = &pl->pieces[p];
+		if (piece->worker != worker)
+			continue;
+		const TokenStream *tokens = piece->tokens;
+		uint32_t n = piece->count, out = piece->out;
+		memcpy(stream->token + out, tokens->token + piece->first, n * sizeof stream->token[0]);
+		memcpy(stream->offset + out, tokens->offset + piece->first, n * sizeof stream->offset[0]);
+		memcpy(stream->length + out, tokens->length + piece->first, n * sizeof stream->length[0]);
+		memcpy(stream->seminfo + out, tokens->seminfo + piece->first, n * sizeof stream->seminfo[0]);
+		for (uint32_t i = 0; i < n; i++)
+			stream->line[out + i] = tokens->line[piece->first + i] + piece->line_delta;
+		if (!worker || pl->container->interner)
+			continue;
+		/* all strings are in the main compiler state by now, so looking them up is safe */
+		for (uint32_t i = out; i < out + n; i++) {
+			int token = stream->token[i];
+			if (token != TOK_NAME && token != TOK_STRING && token != '@')
+				continue;
+			const struct string_object *s = stream->seminfo[i].ts;
+			if (s->reserved < 0)
+				stream->seminfo[i].ts = string_set_find(strings, s->hash, s);
+		}
+	}
+}
+
+static void copy_worker_pieces(void *arg)
+{
+	struct lex_worker *worker = (struct lex_worker *)arg;
+	copy_pieces(worker->pl, worker);
+}
+
+/* Runs fn for each worker on a thread of its own, or on this thread if a thread cannot be started */
+static void run_workers(struct parallel_lexer *pl, raviX_thread_function fn, void (*main_fn)(struct parallel_lexer *))
+{
+	for (unsigned i = 0; i < pl->nworkers; i++)
+		pl->workers[i].started = raviX_thread_start(&pl->workers[i].thread, fn, &pl->workers[i]);
+	if (main_fn)
+		main_fn(pl);
+	for (unsigned i = 0; i < pl->nworkers; i++) {
+		if (pl->workers[i].started)
+			raviX_thread_join(&pl->workers[i].thread);
+		else
+			fn(&pl->workers[i]);
+	}
+}
+
+static void build_lines(struct parallel_lexer *pl)
+{
+	build_line_table(&pl->container->memory, &pl->container->lines, pl->buf, pl->buflen);
+}
+
+static void copy_main_pieces(struct parallel_lexer *pl) { copy_pieces(pl, NULL); }
+
+/* Chooses where the slices start: at the first line break after equally spaced points if possible */
+static void split_input(struct parallel_lexer *pl)
+{
+	size_t size = pl->buflen / pl->nslices;
+	for (unsigned i = 0; i < pl->nslices; i++) {
+		size_t start = i * size;
+		if (i > 0) {
+			size_t n = raviX_scan_newline(pl->buf + start, size);
+			if (n < size)
+				start += n + 1;
+		}
+		pl->slices[i].start = start;
+		if (i > 0)
+			pl->slices[i - 1].end = start;
+	}
+	pl->slices[pl->nslices - 1].end = pl->buflen + 1; /* so that the last slice includes TOK_EOS */
+}
+
+/* Moves the strings of the workers' tokens to the main compiler state, and puts the pieces together */
+static void merge_pieces(struct parallel_lexer *pl)
+{
+	struct compiler_state *container = pl->container;
+	/* with a shared interner the workers' strings are already the final ones */
+	if (!container->interner) {
+		/* the workers mostly see the same names, so size the table for the biggest of them */
+		uint32_t most = 0;
+		for (unsigned i = 0; i < pl->nworkers; i++) {
+			if (pl->workers[i].container->strings.count > most)
+				most = pl->workers[i].container->strings.count;
+		}
+		string_set_reserve(&container->strings, container->strings.count + most);
+	}
+	/* only the strings of tokens that are kept: a slice that started in the wrong place also interned the
+	 * contents of strings and comments, which the sequential lexer would not have seen */
+	raviX_create_string(container, LUA_ENV, (uint32_t)strlen(LUA_ENV)); /* as a lexer would have */
+	for (unsigned p = 0; p < pl->npieces && !container->interner; p++) {
+		const struct lex_piece *piece = &pl->pieces[p];
+		if (!piece->worker)
+			continue;
+		const TokenStream *tokens = piece->tokens;
+		for (uint32_t i = piece->first; i < piece->first + piece->count; i++) {
+			int token = tokens->token[i];
+			if (token != TOK_NAME && token != TOK_STRING && token != '@')
+				continue;
+			const struct string_object *s = tokens->seminfo[i].ts;
+			if (s->reserved >= 0)
+				continue; /* keywords are not interned */
+			bool in_source = s->str >= pl->buf && s->str < pl->buf + pl->buflen;
+			intern_string(container, s->str, s->len, s->hash, container->zero_copy_strings && in_source);
+		}
+	}
+	uint32_t count = 0;
+	for (unsigned p = 0; p < pl->npieces; p++) {
+		pl->pieces[p].out = count;
+		count += pl->pieces[p].count;
+	}
+	TokenStream *stream = pl->stream;
+	if (count > stream->capacity && !resize_token_stream(container, stream, count))
+		raviX_out_of_memory(&container->memory);
+	run_workers(pl, copy_worker_pieces, copy_main_pieces);
+	stream->count = count;
+}
+
+static int lex_all_parallel(struct compiler_state *container, const char *buf, size_t buflen,
+			    const char *source_name, TokenStream *stream, unsigned threads, size_t slice_size)
+{
+	if (threads == 0)
+		threads = raviX_hardware_threads();
+	if (slice_size == 0)
+		slice_size = buflen / threads > MIN_SLICE_SIZE ? buflen / threads : MIN_SLICE_SIZE;
+	size_t nslices = buflen / slice_size;
+	if (threads < 2 || nslices < 2 || buflen >= UINT32_MAX)
+		return lex_all(container, buf, buflen, source_name, stream);
+	if (nslices > UINT_MAX / 4)
+		nslices = UINT_MAX / 4;
+	stream->count = 0;
+	stream->source = buf;
+
+	struct parallel_lexer pl;
+	memset(&pl, 0, sizeof pl);
+	pl.container = container;
+	pl.buf = buf;
+	pl.buflen = buflen;
+	pl.source_name = source_name;
+	pl.stream = stream;
+	pl.nslices = (unsigned)nslices;
+	pl.nworkers = threads < pl.nslices ? threads : pl.nslices;
+	struct memory_context *memory = &container->memory;
+	pl.slices = (struct lex_slice *)raviX_try_calloc(memory, pl.nslices, sizeof pl.slices[0]);
+	pl.workers = (struct lex_worker *)raviX_try_calloc(memory, pl.nworkers, sizeof pl.workers[0]);
+	pl.pieces = (struct lex_piece *)raviX_try_calloc(memory, (size_t)pl.nslices * 3, sizeof pl.pieces[0]);
+	int rc = 1;
+	if (!pl.slices || !pl.workers || !pl.pieces) {
+		memory->failed = true;
+		goto L_exit;
+	}
+	for (unsigned i = 0; i < pl.nworkers; i++) {
+		/* the workers allocate from the same hooks, on their own threads */
+		pl.workers[i].container = raviX_init_compiler_with_allocator(&memory->hooks);
+		if (!pl.workers[i].container) {
+			memory->failed = true;
+			goto L_exit;
+		}
+		/* strings found in the source are copied, if needed, when moved to the main compiler state */
+		pl.workers[i].container->zero_copy_strings = true;
+		pl.workers[i].container->interner = container->interner;
+		pl.workers[i].pl = &pl;
+		pl.workers[i].index = i;
+	}
+	split_input(&pl);
+	/* the line table is built by the main thread while the workers lex the slices */
+	run_workers(&pl, lex_slices, build_lines);
+
+	/* line breaks seen by the main thread are already in the line table */
+	struct line_table lines = container->lines;
+	memset(&container->lines, 0, sizeof container->lines);
+	raviX_catch_memory_errors(container);
+	rc = setjmp(container->env);
+	if (rc == 0)
+		reconcile_slices(&pl);
+	raviX_end_memory_errors(container);
+	raviX_free(memory, container->lines.starts);
+	container->lines = lines;
+	if (pl.ls) {
+		raviX_destroy_lexer(pl.ls);
+		pl.ls = NULL;
+	}
+	if (rc == 0) {
+		raviX_catch_memory_errors(container);
+		rc = setjmp(container->env);
+		if (rc == 0)
+			merge_pieces(&pl);
+		raviX_end_memory_errors(container);
+	}
+
+L_exit:
+	for (unsigned i = 0; pl.workers && i < pl.nworkers; i++)
+		raviX_destroy_compiler(pl.workers[i].container);
+	for (unsigned i = 0; pl.slices && i < pl.nslices; i++)
+		raviX_destroy_token_stream(&pl.slices[i].tokens);
+	raviX_destroy_token_stream(&pl.relexed);
+	raviX_free(memory, pl.slices);
+	raviX_free(memory, pl.workers);
+	raviX_free(memory, pl.pieces);
+	return rc;
+}
+
+int raviX_lex_all_parallel(struct compiler_state *container, const char *buf, size_t buflen,
+			   const char *source_name, TokenStream *stream, unsigned threads, size_t slice_size)
+{
+	struct phase_timer timer;
+	raviX_begin_phase(container, &timer);
+	int rc = lex_all_parallel(container, buf, buflen, source_name, stream, threads, slice_size);
+	raviX_end_phase(container, COMPILER_PHASE_LEX, &timer);
+	return rc;
+}
+
+void raviX_destroy_token_stream(TokenStream *stream)
+{
+	void *arrays[] = {stream->token, stream->offset, stream->length, stream->line, stream->seminfo};
+	for (int i = 0; i < ARRAY_SIZE(arrays); i++) {
+		if (arrays[i])
+			stream->allocator.free(stream->allocator.user_data, arrays[i]);
+	}
+	memset(stream, 0, sizeof *stream);
+}
+
+const char *raviX_get_last_error(struct compiler_state *container)
+{
+	if (container->memory.failed)
+		return "out of memory";
+	return container->error_message.buf;
+}
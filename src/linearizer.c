@@ -70,23 +70,30 @@ static inline void free_register(struct proc *proc, struct pseudo_generator *gen
 /* Linearizer initialization  */
 struct linearizer_state *raviX_init_linearizer(struct compiler_state *container)
 {
-	struct linearizer_state *linearizer = (struct linearizer_state *)calloc(1, sizeof(struct linearizer_state));
+	struct memory_context *memory = &container->memory;
+	struct linearizer_state *linearizer =
+	    (struct linearizer_state *)raviX_try_calloc(memory, 1, sizeof(struct linearizer_state));
+	if (!linearizer) {
+		memory->failed = true;
+		return NULL;
+	}
 	linearizer->ast_container = container;
 	raviX_allocator_init(&linearizer->edge_allocator, "edge_allocator", sizeof(struct edge), sizeof(double),
-			     sizeof(struct edge) * 32);
+			     sizeof(struct edge) * 32, memory);
 	raviX_allocator_init(&linearizer->instruction_allocator, "instruction_allocator", sizeof(struct instruction),
-			     sizeof(double), sizeof(struct instruction) * 128);
+			     sizeof(double), sizeof(struct instruction) * 128, memory);
 	raviX_allocator_init(&linearizer->ptrlist_allocator, "ptrlist_allocator", sizeof(struct ptr_list),
-			     sizeof(double), sizeof(struct ptr_list) * 64);
+			     sizeof(double), sizeof(struct ptr_list) * 64, memory);
 	raviX_allocator_init(&linearizer->pseudo_allocator, "pseudo_allocator", sizeof(struct pseudo), sizeof(double),
-			     sizeof(struct pseudo) * 128);
+			     sizeof(struct pseudo) * 128, memory);
 	raviX_allocator_init(&linearizer->basic_block_allocator, "basic_block_allocator", sizeof(struct basic_block),
-			     sizeof(double), sizeof(struct basic_block) * 32);
+			     sizeof(double), sizeof(struct basic_block) * 32, memory);
 	raviX_allocator_init(&linearizer->proc_allocator, "proc_allocator", sizeof(struct proc), sizeof(double),
-			     sizeof(struct proc) * 32);
-	raviX_allocator_init(&linearizer->unsized_allocator, "unsized_allocator", 0, sizeof(double), CHUNK);
+			     sizeof(struct proc) * 32, memory);
+	raviX_allocator_init(&linearizer->unsized_allocator, "unsized_allocator", 0, sizeof(double), CHUNK, memory);
 	raviX_allocator_init(&linearizer->constant_allocator, "constant_allocator", sizeof(struct constant),
-			     sizeof(double), sizeof(struct constant) * 64);
+			     sizeof(double), sizeof(struct constant) * 64, memory);
+	constant_set_init(&linearizer->constants, memory);
 	linearizer->proc_id = 0;
 	return linearizer;
 }
@@ -95,13 +102,7 @@ void raviX_destroy_linearizer(struct linearizer_state *linearizer)
 {
 	if (linearizer == NULL)
 		return;
-	struct proc *proc;
-	FOR_EACH_PTR(linearizer->all_procs, proc)
-	{
-		if (proc->constants)
-			set_destroy(proc->constants, NULL);
-	}
-	END_FOR_EACH_PTR(proc)
+	constant_set_destroy(&linearizer->constants);
 	raviX_allocator_destroy(&linearizer->edge_allocator);
 	raviX_allocator_destroy(&linearizer->instruction_allocator);
 	raviX_allocator_destroy(&linearizer->ptrlist_allocator);
@@ -110,66 +111,29 @@ void raviX_destroy_linearizer(struct linearizer_state *linearizer)
 	raviX_allocator_destroy(&linearizer->proc_allocator);
 	raviX_allocator_destroy(&linearizer->unsized_allocator);
 	raviX_allocator_destroy(&linearizer->constant_allocator);
-	free(linearizer);
-}
-
-/**
- * We assume strings are all interned and can be compared by
- * address
- */
-static int compare_constants(const void *a, const void *b)
-{
-	const struct constant *c1 = (const struct constant *)a;
-	const struct constant *c2 = (const struct constant *)b;
-	if (c1->type != c2->type)
-		return 1;
-	if (c1->type == RAVI_TNUMINT)
-		return c1->i == c2->i;
-	else if (c1->type == RAVI_TNUMFLT)
-		return c1->n == c2->n;
-	else
-		return c1->s == c2->s;
-}
-
-/**
- * Hashes a constant
- */
-static uint32_t hash_constant(const void *c)
-{
-	const struct constant *c1 = (const struct constant *)c;
-	if (c1->type == RAVI_TNUMINT)
-		return (uint32_t)c1->i;
-	else if (c1->type == RAVI_TNUMFLT)
-		return (uint32_t)c1->n; // FIXME maybe use Lua's hash gen
-	else
-		return (uint32_t)c1->s->hash;
+	raviX_free(&linearizer->ast_container->memory, linearizer);
 }
 
 /**
- * Adds a constant to the proc's constant table. The constant is also assigned a
- * pseudo register.
+ * Adds a constant to the chunk's constant pool, unless an equal one is there already.
+ * The constant's index in the pool acts as its pseudo register.
  */
 static const struct constant *add_constant(struct proc *proc, const struct constant *c)
 {
-	struct set_entry *entry = set_search(proc->constants, c);
-	if (entry == NULL) {
-		int reg = proc->num_constants++;
-		struct constant *c1 = raviX_allocator_allocate(&proc->linearizer->constant_allocator, 0);
-		assert(c1); // FIXME
-		memcpy(c1, c, sizeof(struct constant));
-		c1->index = reg;
-		set_add(proc->constants, c1);
-		// printf("Created new constant and assigned reg %d\n", reg);
-		return c1;
-	} else {
-		const struct constant *c1 = entry->key;
-		// printf("Found constant at reg %d\n", c1->index);
-		return c1;
-	}
+	struct linearizer_state *linearizer = proc->linearizer;
+	uint32_t hash = constant_hash(c);
+	const struct constant *found = constant_set_find(&linearizer->constants, hash, c);
+	if (found != NULL)
+		return found;
+	struct constant *c1 = raviX_allocator_allocate(&linearizer->constant_allocator, 0);
+	memcpy(c1, c, sizeof(struct constant));
+	c1->index = linearizer->constants.count;
+	constant_set_insert(&linearizer->constants, hash, c1);
+	return c1;
 }
 
 /**
- * Allocates and adds a constant to the Proc's constants table.
+ * Allocates and adds a constant to the chunk's constant pool.
  * Input is expected to be EXPR_LITERAL
  */
 static const struct constant *allocate_constant(struct proc *proc, struct ast_node *node)
@@ -207,6 +171,7 @@ static struct pseudo *allocate_symbol_pseudo(struct proc *proc, struct lua_symbo
 		assert(sym->variable.pseudo == NULL);
 		sym->variable.pseudo = pseudo;
 	}
+	ptrlist_add((struct ptr_list **)&proc->linearizer->symbol_pseudos, pseudo, &proc->linearizer->ptrlist_allocator);
 	return pseudo;
 }
 
@@ -351,7 +316,6 @@ static struct proc *allocate_proc(struct linearizer_state *linearizer, struct as
 		proc->parent = linearizer->current_proc;
 		ptrlist_add((struct ptr_list **)&linearizer->current_proc->procs, proc, &linearizer->ptrlist_allocator);
 	}
-	proc->constants = set_create(hash_constant, compare_constants);
 	proc->linearizer = linearizer;
 	return proc;
 }
@@ -386,8 +350,8 @@ static void linearize_function_args(struct linearizer_state *linearizer)
 static void linearize_statement_list(struct proc *proc, struct ast_node_list *list)
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(list, node) { linearize_statement(proc, node); }
-	END_FOR_EACH_PTR(node)
+	FOR_EACH_FROZEN_PTR(list, node) { linearize_statement(proc, node); }
+	END_FOR_EACH_FROZEN_PTR(node)
 }
 
 static struct instruction *allocate_instruction(struct proc *proc, enum opcode op)
@@ -1003,7 +967,7 @@ static struct pseudo *linearize_function_call_expression(struct proc *proc, stru
 
 	struct ast_node *arg;
 	int argc = ptrlist_size((const struct ptr_list *)expr->function_call_expr.arg_list);
-	FOR_EACH_PTR(expr->function_call_expr.arg_list, arg)
+	FOR_EACH_FROZEN_PTR(expr->function_call_expr.arg_list, arg)
 	{
 		argc -= 1;
 		struct pseudo *arg_pseudo = linearize_expression(proc, arg);
@@ -1013,7 +977,7 @@ static struct pseudo *linearize_function_call_expression(struct proc *proc, stru
 		}
 		add_instruction_operand(proc, insn, arg_pseudo);
 	}
-	END_FOR_EACH_PTR(arg)
+	END_FOR_EACH_FROZEN_PTR(arg)
 
 	struct pseudo *return_pseudo = allocate_range_pseudo(
 	    proc, callsite_pseudo); /* Base reg for function call - where return values will be placed */
@@ -1042,7 +1006,7 @@ static struct pseudo *linearize_suffixedexpr(struct proc *proc, struct ast_node
 	struct pseudo *prev_pseudo = linearize_expression(proc, node->suffixed_expr.primary_expr);
 	struct ast_node *prev_node = node->suffixed_expr.primary_expr;
 	struct ast_node *this_node;
-	FOR_EACH_PTR(node->suffixed_expr.suffix_list, this_node)
+	FOR_EACH_FROZEN_PTR(node->suffixed_expr.suffix_list, this_node)
 	{
 		struct pseudo *next;
 		if (prev_pseudo->type == PSEUDO_RANGE)
@@ -1061,7 +1025,7 @@ static struct pseudo *linearize_suffixedexpr(struct proc *proc, struct ast_node
 		prev_node = this_node;
 		prev_pseudo = next;
 	}
-	END_FOR_EACH_PTR(node)
+	END_FOR_EACH_FROZEN_PTR(node)
 	return prev_pseudo;
 }
 
@@ -1103,11 +1067,11 @@ static struct pseudo *linearize_table_constructor(struct proc *proc, struct ast_
 	/*TODO process constructor elements */
 	struct ast_node *ia;
 	int i = 1;
-	FOR_EACH_PTR(expr->table_expr.expr_list, ia)
+	FOR_EACH_FROZEN_PTR(expr->table_expr.expr_list, ia)
 	{
 		i = linearize_indexed_assign(proc, target, expr->table_expr.type.type_code, ia, i);
 	}
-	END_FOR_EACH_PTR(ia)
+	END_FOR_EACH_FROZEN_PTR(ia)
 
 	return target;
 }
@@ -1140,7 +1104,7 @@ static void linearize_assignment(struct proc *proc, struct ast_node_list *expr_l
 	struct node_info *valinfo = (struct node_info *)alloca(ne * sizeof(struct node_info));
 	struct pseudo *last_val_pseudo = NULL;
 	int i = 0;
-	FOR_EACH_PTR(expr_list, expr)
+	FOR_EACH_FROZEN_PTR(expr_list, expr)
 	{
 		struct pseudo *val_pseudo = last_val_pseudo = linearize_expression(proc, expr);
 		valinfo[i].type_code = expr->common_expr.type.type_code;
@@ -1150,7 +1114,7 @@ static void linearize_assignment(struct proc *proc, struct ast_node_list *expr_l
 			convert_range_to_temp(val_pseudo);
 		}
 	}
-	END_FOR_EACH_PTR(expr)
+	END_FOR_EACH_FROZEN_PTR(expr)
 
 	/* TODO do we need to insert type assertions in some cases such as function return values ? */
 
@@ -1222,14 +1186,14 @@ static void linearize_expression_statement(struct proc *proc, struct ast_node *n
 	int nv = ptrlist_size((const struct ptr_list *)node->expression_stmt.var_expr_list);
 	struct node_info *varinfo = (struct node_info *)alloca(nv * sizeof(struct node_info));
 	int i = 0;
-	FOR_EACH_PTR(node->expression_stmt.var_expr_list, var)
+	FOR_EACH_FROZEN_PTR(node->expression_stmt.var_expr_list, var)
 	{
 		struct pseudo *var_pseudo = linearize_expression(proc, var);
 		varinfo[i].type_code = var->common_expr.type.type_code;
 		varinfo[i].pseudo = var_pseudo;
 		i++;
 	}
-	END_FOR_EACH_PTR(var)
+	END_FOR_EACH_FROZEN_PTR(var)
 
 	linearize_assignment(proc, node->expression_stmt.expr_list, varinfo, nv);
 }
@@ -1242,7 +1206,7 @@ static void linearize_local_statement(struct proc *proc, struct ast_node *stmt)
 	struct node_info *varinfo = (struct node_info *)alloca(nv * sizeof(struct node_info));
 	int i = 0;
 
-	FOR_EACH_PTR(stmt->local_stmt.var_list, sym)
+	FOR_EACH_FROZEN_PTR(stmt->local_stmt.var_list, sym)
 	{
 		struct pseudo *var_pseudo = sym->variable.pseudo;
 		assert(var_pseudo);
@@ -1250,7 +1214,7 @@ static void linearize_local_statement(struct proc *proc, struct ast_node *stmt)
 		varinfo[i].pseudo = var_pseudo;
 		i++;
 	}
-	END_FOR_EACH_PTR(var)
+	END_FOR_EACH_FROZEN_PTR(var)
 
 	linearize_assignment(proc, stmt->local_stmt.expr_list, varinfo, nv);
 }
@@ -1296,7 +1260,7 @@ static void linearize_expr_list(struct proc *proc, struct ast_node_list *expr_li
 {
 	struct ast_node *expr;
 	int ne = ptrlist_size((const struct ptr_list *)expr_list);
-	FOR_EACH_PTR(expr_list, expr)
+	FOR_EACH_FROZEN_PTR(expr_list, expr)
 	{
 		ne -= 1;
 		struct pseudo *pseudo = linearize_expression(proc, expr);
@@ -1305,7 +1269,7 @@ static void linearize_expr_list(struct proc *proc, struct ast_node_list *expr_li
 		}
 		ptrlist_add((struct ptr_list **)pseudo_list, pseudo, &proc->linearizer->ptrlist_allocator);
 	}
-	END_FOR_EACH_PTR(expr)
+	END_FOR_EACH_FROZEN_PTR(expr)
 }
 
 static void linearize_return(struct proc *proc, struct ast_node *node)
@@ -1414,19 +1378,19 @@ static void linearize_if_statement(struct proc *proc, struct ast_node *ifnode)
 	struct block_scope *else_scope = ifnode->if_stmt.else_block;
 
 	struct ast_node *this_node;
-	FOR_EACH_PTR(if_else_stmts, this_node)
+	FOR_EACH_FROZEN_PTR(if_else_stmts, this_node)
 	{
 		struct basic_block *block = create_block(proc);
 		ptrlist_add((struct ptr_list **)&if_blocks, block, &proc->linearizer->ptrlist_allocator);
 	}
-	END_FOR_EACH_PTR(this_node)
+	END_FOR_EACH_FROZEN_PTR(this_node)
 
-	FOR_EACH_PTR(if_else_stmts, this_node)
+	FOR_EACH_FROZEN_PTR(if_else_stmts, this_node)
 	{
 		struct basic_block *block = create_block(proc);
 		ptrlist_add((struct ptr_list **)&if_true_blocks, block, &proc->linearizer->ptrlist_allocator);
 	}
-	END_FOR_EACH_PTR(this_node)
+	END_FOR_EACH_FROZEN_PTR(this_node)
 
 	if (ifnode->if_stmt.else_statement_list) {
 		else_block = create_block(proc);
@@ -1441,7 +1405,7 @@ static void linearize_if_statement(struct proc *proc, struct ast_node *ifnode)
 	{
 		PREPARE_PTR_LIST(if_blocks, block);
 		PREPARE_PTR_LIST(if_true_blocks, true_block);
-		FOR_EACH_PTR(if_else_stmts, this_node)
+		FOR_EACH_FROZEN_PTR(if_else_stmts, this_node)
 		{
 			start_block(proc, block);
 			NEXT_PTR_LIST(block);
@@ -1457,18 +1421,18 @@ static void linearize_if_statement(struct proc *proc, struct ast_node *ifnode)
 			linearize_test_cond(proc, this_node, true_block, false_block);
 			NEXT_PTR_LIST(true_block);
 		}
-		END_FOR_EACH_PTR(node)
+		END_FOR_EACH_FROZEN_PTR(node)
 		FINISH_PTR_LIST(block);
 		FINISH_PTR_LIST(true_block);
 	}
 	{
 		PREPARE_PTR_LIST(if_true_blocks, true_block);
-		FOR_EACH_PTR(if_else_stmts, this_node)
+		FOR_EACH_FROZEN_PTR(if_else_stmts, this_node)
 		{
 			linearize_test_then(proc, this_node, true_block, end_block);
 			NEXT_PTR_LIST(true_block);
 		}
-		END_FOR_EACH_PTR(node)
+		END_FOR_EACH_FROZEN_PTR(node)
 		FINISH_PTR_LIST(true_block);
 	}
 
@@ -1622,14 +1586,14 @@ static void linearize_for_num_statement(struct proc *proc, struct ast_node *node
 
 	/* For now we only allow integer expressions */
 	struct ast_node *expr;
-	FOR_EACH_PTR(node->for_stmt.expr_list, expr)
+	FOR_EACH_FROZEN_PTR(node->for_stmt.expr_list, expr)
 	{
 		if (expr->common_expr.type.type_code != RAVI_TNUMINT) {
 			handle_error(proc->linearizer->ast_container,
 				     "Only for loops with integer expressions currently supported");
 		}
 	}
-	END_FOR_EACH_PTR(expr)
+	END_FOR_EACH_FROZEN_PTR(expr)
 
 	struct ast_node *index_var_expr = ptrlist_nth_entry((struct ptr_list *)node->for_stmt.expr_list, 0);
 	struct ast_node *limit_expr = ptrlist_nth_entry((struct ptr_list *)node->for_stmt.expr_list, 1);
@@ -1807,7 +1771,8 @@ static void linearize_statement(struct proc *proc, struct ast_node *node)
 static struct basic_block *create_block(struct proc *proc)
 {
 	if (proc->node_count >= proc->allocated) {
-		unsigned new_size = proc->allocated + 25;
+		/* the old array stays in the arena, so grow geometrically to bound the waste */
+		unsigned new_size = proc->allocated ? proc->allocated * 2 : 32;
 		struct node **new_data =
 		    raviX_allocator_allocate(&proc->linearizer->unsized_allocator, new_size * sizeof(struct node *));
 		assert(new_data != NULL);
@@ -1860,7 +1825,7 @@ static void start_scope(struct linearizer_state *linearizer, struct proc *proc,
 {
 	proc->current_scope = scope;
 	struct lua_symbol *sym;
-	FOR_EACH_PTR(scope->symbol_list, sym)
+	FOR_EACH_FROZEN_PTR(scope->symbol_list, sym)
 	{
 		if (sym->symbol_type == SYM_LOCAL) {
 			uint8_t reg = allocate_register(&proc->local_pseudos);
@@ -1868,7 +1833,7 @@ static void start_scope(struct linearizer_state *linearizer, struct proc *proc,
 			// printf("Assigning register %d to local %s\n", (int)reg, getstr(sym->var.var_name));
 		}
 	}
-	END_FOR_EACH_PTR(sym)
+	END_FOR_EACH_FROZEN_PTR(sym)
 }
 
 /**
@@ -1906,6 +1871,21 @@ static void linearize_function(struct linearizer_state *linearizer)
 	end_scope(linearizer, proc);
 }
 
+/* string objects are not 0 terminated; as with "%.*s" an embedded 0 ends the output */
+static void output_string_object(const struct string_object *s, membuff_t *mb)
+{
+	const char *nul = (const char *)memchr(s->str, 0, s->len);
+	raviX_buffer_add_bytes(mb, s->str, nul ? (size_t)(nul - s->str) : s->len);
+}
+
+/* Appends prefix(n) */
+static void output_numbered(const char *prefix, int n, membuff_t *mb)
+{
+	raviX_buffer_add_string(mb, prefix);
+	raviX_buffer_add_int(mb, n);
+	raviX_buffer_add_char(mb, ')');
+}
+
 static void output_pseudo(struct pseudo *pseudo, membuff_t *mb)
 {
 	switch (pseudo->type) {
@@ -1913,31 +1893,33 @@ static void output_pseudo(struct pseudo *pseudo, membuff_t *mb)
 		const struct constant *constant = pseudo->constant;
 		const char *tc = "";
 		if (constant->type == RAVI_TNUMFLT) {
-			raviX_buffer_add_fstring(mb, "%.12f", constant->n);
-			tc = "flt";
+			raviX_buffer_add_double(mb, constant->n, 12);
+			tc = " Kflt(";
 		} else if (constant->type == RAVI_TNUMINT) {
-			raviX_buffer_add_fstring(mb, "%lld", (long long)constant->i);
-			tc = "int";
+			raviX_buffer_add_longlong(mb, constant->i);
+			tc = " Kint(";
 		} else {
-			raviX_buffer_add_fstring(mb, "'%s'", constant->s->str);
-			tc = "s";
+			raviX_buffer_add_char(mb, '\'');
+			output_string_object(constant->s, mb);
+			raviX_buffer_add_char(mb, '\'');
+			tc = " Ks(";
 		}
-		raviX_buffer_add_fstring(mb, " K%s(%d)", tc, pseudo->regnum);
+		output_numbered(tc, pseudo->regnum, mb);
 	} break;
 	case PSEUDO_TEMP_INT:
-		raviX_buffer_add_fstring(mb, "Tint(%d)", pseudo->regnum);
+		output_numbered("Tint(", pseudo->regnum, mb);
 		break;
 	case PSEUDO_TEMP_FLT:
-		raviX_buffer_add_fstring(mb, "Tflt(%d)", pseudo->regnum);
+		output_numbered("Tflt(", pseudo->regnum, mb);
 		break;
 	case PSEUDO_TEMP_ANY:
-		raviX_buffer_add_fstring(mb, "T(%d)", pseudo->regnum);
+		output_numbered("T(", pseudo->regnum, mb);
 		break;
 	case PSEUDO_RANGE_SELECT:
 		raviX_buffer_add_fstring(mb, "T(%d[%d..])", pseudo->regnum, pseudo->range_pseudo->regnum);
 		break;
 	case PSEUDO_PROC:
-		raviX_buffer_add_fstring(mb, "Proc(%d)", pseudo->proc->id);
+		output_numbered("Proc(", pseudo->proc->id, mb);
 		break;
 	case PSEUDO_NIL:
 		raviX_buffer_add_string(mb, "nil");
@@ -1951,16 +1933,17 @@ static void output_pseudo(struct pseudo *pseudo, membuff_t *mb)
 	case PSEUDO_SYMBOL:
 		switch (pseudo->symbol->symbol_type) {
 		case SYM_LOCAL: {
-			raviX_buffer_add_fstring(mb, "local(%s, %d)", pseudo->symbol->variable.var_name->str,
-						 pseudo->regnum);
+			raviX_buffer_add_string(mb, "local(");
+			output_string_object(pseudo->symbol->variable.var_name, mb);
+			output_numbered(", ", pseudo->regnum, mb);
 			break;
 		}
 		case SYM_UPVALUE: {
-			raviX_buffer_add_fstring(mb, "Upval(%u)", pseudo->regnum);
+			output_numbered("Upval(", pseudo->regnum, mb);
 			break;
 		}
 		case SYM_GLOBAL: {
-			raviX_buffer_add_string(mb, pseudo->symbol->variable.var_name->str);
+			output_string_object(pseudo->symbol->variable.var_name, mb);
 			break;
 		}
 		default:
@@ -1969,7 +1952,8 @@ static void output_pseudo(struct pseudo *pseudo, membuff_t *mb)
 		}
 		break;
 	case PSEUDO_BLOCK: {
-		raviX_buffer_add_fstring(mb, "L%d", pseudo->block ? (int)pseudo->block->index : -1);
+		raviX_buffer_add_char(mb, 'L');
+		raviX_buffer_add_int(mb, pseudo->block ? (int)pseudo->block->index : -1);
 		break;
 	}
 	case PSEUDO_RANGE: {
@@ -2009,7 +1993,8 @@ static void output_pseudo_list(struct pseudo_list *list, membuff_t *mb)
 
 static void output_instruction(struct instruction *insn, membuff_t *mb)
 {
-	raviX_buffer_add_fstring(mb, "\t%s", op_codenames[insn->opcode]);
+	raviX_buffer_add_char(mb, '\t');
+	raviX_buffer_add_string(mb, op_codenames[insn->opcode]);
 	if (insn->operands) {
 		output_pseudo_list(insn->operands, mb);
 	}
@@ -2028,7 +2013,8 @@ static void output_instructions(struct instruction_list *list, membuff_t *mb)
 
 static void output_basic_block(struct proc *proc, struct basic_block *bb, membuff_t *mb)
 {
-	raviX_buffer_add_fstring(mb, "L%d", bb->index);
+	raviX_buffer_add_char(mb, 'L');
+	raviX_buffer_add_int(mb, (int)bb->index);
 	if (bb2n(bb) == proc->entry) {
 		raviX_buffer_add_string(mb, " (entry)\n");
 	} else if (bb2n(bb) == proc->exit) {
@@ -2042,29 +2028,107 @@ static void output_basic_block(struct proc *proc, struct basic_block *bb, membuf
 static void output_proc(struct proc *proc, membuff_t *mb)
 {
 	struct basic_block *bb;
-	raviX_buffer_add_fstring(mb, "define Proc(%d)\n", proc->id);
+	output_numbered("define Proc(", proc->id, mb);
+	raviX_buffer_add_char(mb, '\n');
 	for (int i = 0; i < (int)proc->node_count; i++) {
 		bb = n2bb(proc->nodes[i]);
 		output_basic_block(proc, bb, mb);
 	}
 }
 
+/* Copies the linearizer's allocators and object counts to the compiler state's statistics */
+static void record_linearizer_stats(struct linearizer_state *linearizer)
+{
+	struct compiler_stats *stats = &linearizer->ast_container->stats;
+	const struct allocator *allocators[] = {
+	    &linearizer->edge_allocator,	&linearizer->instruction_allocator, &linearizer->ptrlist_allocator,
+	    &linearizer->pseudo_allocator,	&linearizer->basic_block_allocator, &linearizer->proc_allocator,
+	    &linearizer->unsized_allocator, &linearizer->constant_allocator};
+	unsigned n = sizeof allocators / sizeof allocators[0];
+	struct compiler_allocator_stats *out = &stats->allocators[COMPILER_STATE_ALLOCATORS];
+	for (unsigned i = 0; i < n; i++)
+		raviX_allocator_get_stats(allocators[i], &out[i]);
+	stats->allocator_count = COMPILER_STATE_ALLOCATORS + n;
+	stats->instructions = out[1].objects;
+	stats->ptrlist_nodes = out[2].objects;
+	stats->pseudos = out[3].objects;
+	stats->basic_blocks = out[4].objects;
+}
+
 int raviX_ast_linearize(struct linearizer_state *linearizer)
 {
-	struct proc *proc = allocate_proc(linearizer, linearizer->ast_container->main_function);
-	set_main_proc(linearizer, proc);
-	set_current_proc(linearizer, proc);
+	struct phase_timer timer;
+	raviX_begin_phase(linearizer->ast_container, &timer);
+	raviX_catch_memory_errors(linearizer->ast_container);
 	int rc = setjmp(linearizer->ast_container->env);
 	if (rc == 0) {
+		struct proc *proc = allocate_proc(linearizer, linearizer->ast_container->main_function);
+		set_main_proc(linearizer, proc);
+		set_current_proc(linearizer, proc);
 		linearize_function(linearizer);
 	}
 	else {
 		// dump it
 		//raviX_output_linearizer(linearizer, stderr);
 	}
+	raviX_end_memory_errors(linearizer->ast_container);
+	raviX_end_phase(linearizer->ast_container, COMPILER_PHASE_LINEARIZE, &timer);
+	record_linearizer_stats(linearizer);
 	return rc;
 }
 
+/*
+ * The IR only needs the kind, name and type of the symbols its pseudos refer to, so each pseudo
+ * gets a copy of its symbol that has no links into the syntax tree. Strings belong to the
+ * compiler state rather than the syntax tree and are shared.
+ */
+static void detach_from_ast(struct linearizer_state *linearizer)
+{
+	struct pseudo *pseudo;
+	FOR_EACH_PTR(linearizer->symbol_pseudos, pseudo)
+	{
+		const struct lua_symbol *sym = pseudo->symbol;
+		struct lua_symbol *copy = raviX_allocator_allocate(&linearizer->unsized_allocator, sizeof(struct lua_symbol));
+		copy->symbol_type = sym->symbol_type;
+		if (sym->symbol_type == SYM_UPVALUE) {
+			copy->upvalue.value_type = sym->upvalue.value_type;
+			copy->upvalue.upvalue_index = sym->upvalue.upvalue_index;
+		} else {
+			copy->variable.value_type = sym->variable.value_type;
+			copy->variable.var_name = sym->variable.var_name;
+			copy->variable.pseudo = pseudo;
+		}
+		pseudo->symbol = copy;
+	}
+	END_FOR_EACH_PTR(pseudo)
+	struct proc *proc;
+	FOR_EACH_PTR(linearizer->all_procs, proc)
+	{
+		proc->function_expr = NULL;
+		proc->current_scope = NULL;
+	}
+	END_FOR_EACH_PTR(proc)
+}
+
+int raviX_linearizer_release_ast(struct linearizer_state *linearizer)
+{
+	struct compiler_state *container = linearizer->ast_container;
+	raviX_catch_memory_errors(container);
+	int rc = setjmp(container->env);
+	if (rc == 0)
+		detach_from_ast(linearizer);
+	raviX_end_memory_errors(container);
+	if (rc != 0)
+		return rc;
+	container->main_function = NULL;
+	raviX_allocator_drop_all_allocations(&container->ast_node_allocator);
+	raviX_allocator_drop_all_allocations(&container->ptrlist_allocator);
+	raviX_allocator_drop_all_allocations(&container->frozen_list_allocator);
+	raviX_allocator_drop_all_allocations(&container->block_scope_allocator);
+	raviX_allocator_drop_all_allocations(&container->symbol_allocator);
+	return 0;
+}
+
 void raviX_show_linearizer(struct linearizer_state *linearizer, membuff_t *mb)
 {
 	output_proc(linearizer->main_proc, mb);
@@ -2078,10 +2142,24 @@ void raviX_show_linearizer(struct linearizer_state *linearizer, membuff_t *mb)
 	END_FOR_EACH_PTR(proc)
 }
 
-void raviX_output_linearizer(struct linearizer_state *linearizer, FILE *fp)
+int raviX_write_linearizer(struct linearizer_state *linearizer, raviX_Writer writer, void *writer_data)
 {
+	struct compiler_state *container = linearizer->ast_container;
 	membuff_t mb;
-	raviX_buffer_init(&mb, 4096);
-	raviX_show_linearizer(linearizer, &mb);
-	fputs(mb.buf, fp);
+	memset(&mb, 0, sizeof mb); /* nothing to free if the buffer cannot be allocated */
+	raviX_catch_memory_errors(container);
+	int rc = setjmp(container->env);
+	if (rc == 0) {
+		raviX_buffer_init_with_writer(&mb, OUTPUT_CHUNK_SIZE, &container->memory, writer, writer_data);
+		raviX_show_linearizer(linearizer, &mb);
+		raviX_buffer_flush(&mb);
+	}
+	raviX_end_memory_errors(container);
+	raviX_buffer_free(&mb);
+	return rc;
+}
+
+int raviX_output_linearizer(struct linearizer_state *linearizer, FILE *fp)
+{
+	return raviX_write_linearizer(linearizer, raviX_buffer_write_to_file, fp);
 }
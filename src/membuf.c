@@ -3,9 +3,11 @@ Copyright (C) 2018-2020 Dibyendu Majumdar
 */
 
 #include "membuf.h"
+#include "allocate.h"
 
 #include <assert.h>
 #include <inttypes.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -20,94 +22,158 @@ void raviX_string_copy(char *buf, const char *src, size_t buflen)
 	buf[buflen - 1] = 0;
 }
 
-void raviX_buffer_init(membuff_t *mb, size_t initial_size)
+void raviX_buffer_init(membuff_t *mb, size_t initial_size) { raviX_buffer_init_with_memory(mb, initial_size, NULL); }
+void raviX_buffer_init_with_memory(membuff_t *mb, size_t initial_size, struct memory_context *memory)
 {
-	if (initial_size > 0) {
-		mb->buf = (char *)calloc(1, initial_size);
-		if (mb->buf == NULL) {
-			fprintf(stderr, "out of memory\n");
-			exit(1);
-		}
-	} else
+	mb->memory = memory;
+	if (initial_size > 0)
+		mb->buf = (char *)raviX_calloc(memory, 1, initial_size);
+	else
 		mb->buf = NULL;
 	mb->pos = 0;
 	mb->allocated_size = initial_size;
+	mb->writer = NULL;
+	mb->writer_data = NULL;
+}
+void raviX_buffer_init_with_writer(membuff_t *mb, size_t chunk_size, struct memory_context *memory,
+				   raviX_Writer writer, void *writer_data)
+{
+	raviX_buffer_init_with_memory(mb, chunk_size, memory);
+	mb->writer = writer;
+	mb->writer_data = writer_data;
+}
+void raviX_buffer_write_to_file(void *fp, const char *bytes, size_t size) { fwrite(bytes, 1, size, (FILE *)fp); }
+void raviX_buffer_flush(membuff_t *mb)
+{
+	if (mb->writer == NULL || mb->pos == 0)
+		return;
+	mb->writer(mb->writer_data, mb->buf, mb->pos);
+	mb->pos = 0;
+	mb->buf[0] = 0;
 }
 void raviX_buffer_resize(membuff_t *mb, size_t new_size)
 {
 	if (new_size <= mb->allocated_size)
 		return;
-	char *newmem = (char *)realloc(mb->buf, new_size);
-	if (newmem == NULL) {
-		fprintf(stderr, "Out of memory\n");
-		exit(1);
-	}
+	char *newmem = (char *)raviX_realloc(mb->memory, mb->buf, new_size);
 	mb->buf = newmem;
 	mb->allocated_size = new_size;
 }
 void raviX_buffer_reserve(membuff_t *mb, size_t n)
 {
 	if (mb->allocated_size < mb->pos + n) {
+		/* a buffer with a writer is emptied rather than grown, unless n bytes will not fit at all */
+		if (mb->writer && mb->pos > 0) {
+			raviX_buffer_flush(mb);
+			if (mb->allocated_size >= n)
+				return;
+		}
 		size_t new_size = (((mb->pos + n) * 3 + 30) / 2) & ~15;
 		raviX_buffer_resize(mb, new_size);
 		assert(mb->allocated_size > mb->pos + n);
 	}
 }
-void raviX_buffer_free(membuff_t *mb) { free(mb->buf); }
-void raviX_buffer_add_string(membuff_t *mb, const char *str)
+void raviX_buffer_free(membuff_t *mb) { raviX_free(mb->memory, mb->buf); }
+void raviX_buffer_add_bytes(membuff_t *mb, const char *str, size_t len)
 {
-	size_t len = strlen(str);
-	size_t required_size = mb->pos + len + 1; /* extra byte for NULL terminator */
-	raviX_buffer_resize(mb, required_size);
-	assert(mb->allocated_size - mb->pos > len);
-	raviX_string_copy(&mb->buf[mb->pos], str, mb->allocated_size - mb->pos);
+	raviX_buffer_reserve(mb, len + 1); /* extra byte for NULL terminator */
+	memcpy(mb->buf + mb->pos, str, len);
 	mb->pos += len;
+	mb->buf[mb->pos] = 0;
 }
+void raviX_buffer_add_string(membuff_t *mb, const char *str) { raviX_buffer_add_bytes(mb, str, strlen(str)); }
 
 void raviX_buffer_add_fstring(membuff_t *mb, const char *fmt, ...)
 {
 	va_list args;
-	int estimated_size = 128;
-
-	for (int i = 0; i < 2; i++) {
-		raviX_buffer_reserve(mb, estimated_size); // ensure we have at least estimated_size free space
+	/* format straight into the free space, only if that is too small is it done again */
+	raviX_buffer_reserve(mb, 128);
+	size_t available = mb->allocated_size - mb->pos;
+	va_start(args, fmt);
+	int n = vsnprintf(mb->buf + mb->pos, available, fmt, args);
+	va_end(args);
+	if (n < 0) {
+		fprintf(stderr, "Buffer conversion error\n");
+		assert(false);
+		return;
+	}
+	if ((size_t)n >= available) {
+		raviX_buffer_reserve(mb, (size_t)n + 1); /* allow for 0 byte */
 		va_start(args, fmt);
-		int n = vsnprintf(mb->buf + mb->pos, estimated_size, fmt, args);
+		vsnprintf(mb->buf + mb->pos, (size_t)n + 1, fmt, args);
 		va_end(args);
-		if (n > estimated_size) {
-			estimated_size = n + 1; // allow for 0 byte
-		} else if (n < 0) {
-			fprintf(stderr, "Buffer conversion error\n");
-			assert(false);
-			break;
-		} else {
-			mb->pos += n;
-			break;
-		}
 	}
+	mb->pos += n;
 }
 
 void raviX_buffer_add_bool(membuff_t *mb, bool value)
 {
 	if (value)
-		raviX_buffer_add_string(mb, "true");
+		raviX_buffer_add_bytes(mb, "true", 4);
 	else
-		raviX_buffer_add_string(mb, "false");
+		raviX_buffer_add_bytes(mb, "false", 5);
 }
-void raviX_buffer_add_int(membuff_t *mb, int value)
+
+/* Writes the decimal digits of value so that they end just before end, two digits at a time */
+static char *format_digits(char *end, uint64_t value)
 {
-	char temp[100];
-	snprintf(temp, sizeof temp, "%d", value);
-	raviX_buffer_add_string(mb, temp);
+	static const char pairs[] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+				    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+				    "8081828384858687888990919293949596979899";
+	while (value >= 100) {
+		unsigned i = (unsigned)(value % 100) * 2;
+		value /= 100;
+		*--end = pairs[i + 1];
+		*--end = pairs[i];
+	}
+	if (value >= 10) {
+		unsigned i = (unsigned)value * 2;
+		*--end = pairs[i + 1];
+		*--end = pairs[i];
+	} else {
+		*--end = (char)('0' + value);
+	}
+	return end;
 }
+void raviX_buffer_add_int(membuff_t *mb, int value) { raviX_buffer_add_longlong(mb, value); }
 void raviX_buffer_add_longlong(membuff_t *mb, int64_t value)
 {
-	char temp[100];
-	snprintf(temp, sizeof temp, "%" PRId64 "", value);
-	raviX_buffer_add_string(mb, temp);
+	char temp[24];
+	char *end = temp + sizeof temp;
+	char *p = format_digits(end, value < 0 ? 0 - (uint64_t)value : (uint64_t)value);
+	if (value < 0)
+		*--p = '-';
+	raviX_buffer_add_bytes(mb, p, (size_t)(end - p));
+}
+void raviX_buffer_add_double(membuff_t *mb, double value, int digits)
+{
+	/* whole numbers that fit in an integer are the common case and need no rounding */
+	if (value >= -9007199254740992.0 && value <= 9007199254740992.0 && value == (double)(int64_t)value &&
+	    digits >= 0) {
+		raviX_buffer_reserve(mb, (size_t)digits + 24);
+		char temp[24];
+		char *end = temp + sizeof temp;
+		char *p = format_digits(end, (uint64_t)(value < 0 ? -value : value));
+		if (signbit(value))
+			*--p = '-'; /* printf keeps the sign of -0.0 */
+		raviX_buffer_addbytes(mb, p, (size_t)(end - p));
+		if (digits > 0) {
+			raviX_buffer_addc(mb, '.');
+			memset(mb->buf + mb->pos, '0', (size_t)digits);
+			mb->pos += digits;
+		}
+		mb->buf[mb->pos] = 0;
+		return;
+	}
+	/* a double has at most 309 digits before the point */
+	raviX_buffer_reserve(mb, (size_t)(digits > 0 ? digits : 0) + 320);
+	int n = snprintf(mb->buf + mb->pos, mb->allocated_size - mb->pos, "%.*f", digits, value);
+	if (n > 0)
+		mb->pos += n;
 }
 void raviX_buffer_add_char(membuff_t *mb, char c)
 {
-	char temp[2] = {c, '\0'};
-	raviX_buffer_add_string(mb, temp);
+	raviX_buffer_reserve(mb, 2);
+	mb->buf[mb->pos++] = c;
+	mb->buf[mb->pos] = 0;
 }
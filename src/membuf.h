@@ -8,12 +8,18 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+/* the buffer grows through the given memory hooks, NULL for malloc */
+extern void raviX_buffer_init_with_memory(membuff_t *mb, size_t initial_size, struct memory_context *memory);
 extern void raviX_buffer_add_bool(membuff_t *mb, bool value);
-extern void raviX_buffer_add_int(membuff_t *mb, int value);
-extern void raviX_buffer_add_longlong(membuff_t *mb, int64_t value);
 extern void raviX_buffer_add_char(membuff_t *mb, char c);
 
+/* size of the pieces the AST and IR dumps are written in */
+enum { OUTPUT_CHUNK_SIZE = 8192 };
+/* raviX_Writer that appends to the FILE * passed as its data */
+extern void raviX_buffer_write_to_file(void *fp, const char *bytes, size_t size);
+
 /* Following add and remove raw bytes */
 
 /* Unchecked - user must first resize */
@@ -22,6 +28,13 @@ static inline void raviX_buffer_addc(membuff_t *mb, int c)
 	mb->buf[mb->pos++] = (char)c;
 	assert(mb->pos < mb->allocated_size);
 }
+/* Unchecked - user must first reserve */
+static inline void raviX_buffer_addbytes(membuff_t *mb, const char *p, size_t n)
+{
+	memcpy(mb->buf + mb->pos, p, n);
+	mb->pos += n;
+	assert(mb->pos < mb->allocated_size);
+}
 static inline void raviX_buffer_remove(membuff_t *mb, int i) { mb->pos -= i; }
 
 #endif
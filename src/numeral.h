@@ -0,0 +1,18 @@
+#ifndef ravicomp_NUMERAL_H
+#define ravicomp_NUMERAL_H
+
+/*
+ * Conversion of decimal and hexadecimal floating point numerals to doubles.
+ * The result is correctly rounded, so it is the same as what strtod() gives,
+ * but the conversion does not depend upon the locale and does not allocate.
+ */
+
+/*
+ * Converts the numeral at 's' - digits with an optional '.', and an optional
+ * exponent part, or the same in hexadecimal with a '0x' prefix and a binary
+ * exponent - and an optional leading sign. 'inf' and 'nan' are not accepted.
+ * Returns a pointer past the numeral, or NULL if 's' does not start with one.
+ */
+const char *raviX_str2d(const char *s, double *result);
+
+#endif
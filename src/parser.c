@@ -13,6 +13,7 @@ Note that the overall structure of the parser is loosely based on the Lua 5.3 pa
 */
 
 #include "fnv_hash.h"
+#include "threads.h"
 #include <ravi_ast.h>
 
 /* forward declarations */
@@ -41,6 +42,7 @@ static struct ast_node *allocate_ast_node(struct parser_state *parser, enum ast_
 	struct ast_node *node = (struct ast_node *)raviX_allocator_allocate(&parser->container->ast_node_allocator, 0);
 	node->type = type;
 	node->line_number = parser->ls->lastline;
+	node->offset = parser->ls->lastoffset;
 	return node;
 }
 
@@ -103,7 +105,7 @@ static void check_match(struct lexer_state *ls, int what, int who, int where)
 			error_expected(ls, what);
 		else {
 			membuff_t mb;
-			raviX_buffer_init(&mb, 256);
+			raviX_buffer_init_with_memory(&mb, 256, &ls->container->memory);
 			raviX_token2str(what, &mb);
 			raviX_buffer_add_string(&mb, " expected (to close ");
 			raviX_token2str(who, &mb);
@@ -479,6 +481,13 @@ static struct ast_node *parse_table_constructor(struct parser_state *parser)
 
 /* }====================================================================== */
 
+/* Compares a string object with a C string; string objects may not be 0 terminated */
+static inline bool string_equals(const struct string_object *s, const char *cstr)
+{
+	size_t len = strlen(cstr);
+	return s->len == len && memcmp(s->str, cstr, len) == 0;
+}
+
 /*
  * We would like to allow user defined types to contain the sequence
  * NAME [. NAME]+
@@ -493,25 +502,24 @@ static const struct string_object *parse_user_defined_type_name(struct lexer_sta
 	size_t len = 0;
 	if (testnext(ls, '.')) {
 		char buffer[256] = {0};
-		const char *str = typename->str;
-		len = strlen(str);
+		len = typename->len;
 		if (len >= sizeof buffer) {
 			raviX_syntaxerror(ls, "User defined type name is too long");
 			return typename;
 		}
-		snprintf(buffer, sizeof buffer, "%s", str);
+		memcpy(buffer, typename->str, len);
 		do {
 			typename = check_name_and_next(ls);
-			str = typename->str;
-			size_t newlen = len + strlen(str) + 1;
+			size_t newlen = len + typename->len + 1;
 			if (newlen >= sizeof buffer) {
 				raviX_syntaxerror(ls, "User defined type name is too long");
 				return typename;
 			}
-			snprintf(buffer + len, sizeof buffer - len, ".%s", str);
+			buffer[len] = '.';
+			memcpy(buffer + len + 1, typename->str, typename->len);
 			len = newlen;
 		} while (testnext(ls, '.'));
-		typename = raviX_create_string(ls->container, buffer, (uint32_t)strlen(buffer));
+		typename = raviX_create_string(ls->container, buffer, (uint32_t)len);
 	}
 	return typename;
 }
@@ -530,23 +538,22 @@ static struct lua_symbol *parse_local_variable_declaration(struct parser_state *
 	const struct string_object *pusertype = NULL;
 	if (testnext(ls, ':')) {
 		const struct string_object *typename = check_name_and_next(ls); /* we expect a type name */
-		const char *str = typename->str;
 		/* following is not very nice but easy as
 		 * the lexer doesn't need to be changed
 		 */
-		if (strcmp(str, "integer") == 0)
+		if (string_equals(typename, "integer"))
 			tt = RAVI_TNUMINT;
-		else if (strcmp(str, "number") == 0)
+		else if (string_equals(typename, "number"))
 			tt = RAVI_TNUMFLT;
-		else if (strcmp(str, "closure") == 0)
+		else if (string_equals(typename, "closure"))
 			tt = RAVI_TFUNCTION;
-		else if (strcmp(str, "table") == 0)
+		else if (string_equals(typename, "table"))
 			tt = RAVI_TTABLE;
-		else if (strcmp(str, "string") == 0)
+		else if (string_equals(typename, "string"))
 			tt = RAVI_TSTRING;
-		else if (strcmp(str, "boolean") == 0)
+		else if (string_equals(typename, "boolean"))
 			tt = RAVI_TBOOLEAN;
-		else if (strcmp(str, "any") == 0)
+		else if (string_equals(typename, "any"))
 			tt = RAVI_TANY;
 		else {
 			/* default is a userdata type */
@@ -1523,28 +1530,211 @@ static void parser_state_init(struct parser_state *parser, struct lexer_state *l
 	parser->current_scope = NULL;
 }
 
+/*
+** Nothing is added to the lists of a syntax tree once it has been parsed, so
+** each list is frozen into a single array and the nodes it was built from are
+** dropped. Scopes may be reached more than once, freezing is idempotent.
+*/
+static void freeze_list(struct compiler_state *container, void *listp)
+{
+	struct ptr_list **list = (struct ptr_list **)listp;
+	*list = ptrlist_freeze(*list, &container->frozen_list_allocator);
+}
+
+static void freeze_scope(struct compiler_state *container, struct block_scope *scope)
+{
+	if (scope)
+		freeze_list(container, &scope->symbol_list);
+}
+
+static void freeze_node(struct compiler_state *container, struct ast_node *node);
+
+static void freeze_node_list(struct compiler_state *container, struct ast_node_list **list)
+{
+	freeze_list(container, list);
+	struct ast_node *node;
+	FOR_EACH_FROZEN_PTR(*list, node) { freeze_node(container, node); }
+	END_FOR_EACH_FROZEN_PTR(node)
+}
+
+static void freeze_node(struct compiler_state *container, struct ast_node *node)
+{
+	if (!node)
+		return;
+	switch (node->type) {
+	case STMT_RETURN:
+		freeze_node_list(container, &node->return_stmt.expr_list);
+		break;
+	case STMT_GOTO:
+		freeze_scope(container, node->goto_stmt.goto_scope);
+		break;
+	case STMT_DO:
+		freeze_scope(container, node->do_stmt.scope);
+		freeze_node_list(container, &node->do_stmt.do_statement_list);
+		break;
+	case STMT_LOCAL:
+		freeze_list(container, &node->local_stmt.var_list);
+		freeze_node_list(container, &node->local_stmt.expr_list);
+		break;
+	case STMT_FUNCTION:
+		freeze_node(container, node->function_stmt.name);
+		freeze_node_list(container, &node->function_stmt.selectors);
+		freeze_node(container, node->function_stmt.method_name);
+		freeze_node(container, node->function_stmt.function_expr);
+		break;
+	case STMT_IF:
+		freeze_node_list(container, &node->if_stmt.if_condition_list);
+		freeze_scope(container, node->if_stmt.else_block);
+		freeze_node_list(container, &node->if_stmt.else_statement_list);
+		break;
+	case STMT_TEST_THEN:
+		freeze_node(container, node->test_then_block.condition);
+		freeze_scope(container, node->test_then_block.test_then_scope);
+		freeze_node_list(container, &node->test_then_block.test_then_statement_list);
+		break;
+	case STMT_WHILE:
+	case STMT_REPEAT:
+		freeze_node(container, node->while_or_repeat_stmt.condition);
+		freeze_scope(container, node->while_or_repeat_stmt.loop_scope);
+		freeze_node_list(container, &node->while_or_repeat_stmt.loop_statement_list);
+		break;
+	case STMT_FOR_IN:
+	case STMT_FOR_NUM:
+		freeze_scope(container, node->for_stmt.for_scope);
+		freeze_list(container, &node->for_stmt.symbols);
+		freeze_node_list(container, &node->for_stmt.expr_list);
+		freeze_scope(container, node->for_stmt.for_body);
+		freeze_node_list(container, &node->for_stmt.for_statement_list);
+		break;
+	case STMT_EXPR:
+		freeze_node_list(container, &node->expression_stmt.var_expr_list);
+		freeze_node_list(container, &node->expression_stmt.expr_list);
+		break;
+	case EXPR_Y_INDEX:
+	case EXPR_FIELD_SELECTOR:
+		freeze_node(container, node->index_expr.expr);
+		break;
+	case EXPR_TABLE_ELEMENT_ASSIGN:
+		freeze_node(container, node->table_elem_assign_expr.key_expr);
+		freeze_node(container, node->table_elem_assign_expr.value_expr);
+		break;
+	case EXPR_SUFFIXED:
+		freeze_node(container, node->suffixed_expr.primary_expr);
+		freeze_node_list(container, &node->suffixed_expr.suffix_list);
+		break;
+	case EXPR_UNARY:
+		freeze_node(container, node->unary_expr.expr);
+		break;
+	case EXPR_BINARY:
+		freeze_node(container, node->binary_expr.expr_left);
+		freeze_node(container, node->binary_expr.expr_right);
+		break;
+	case EXPR_FUNCTION:
+		/* child functions are reached through the expressions that define them */
+		freeze_scope(container, node->function_expr.main_block);
+		freeze_node_list(container, &node->function_expr.function_statement_list);
+		freeze_list(container, &node->function_expr.args);
+		freeze_list(container, &node->function_expr.child_functions);
+		freeze_list(container, &node->function_expr.upvalues);
+		freeze_list(container, &node->function_expr.locals);
+		break;
+	case EXPR_TABLE_LITERAL:
+		freeze_node_list(container, &node->table_expr.expr_list);
+		break;
+	case EXPR_FUNCTION_CALL:
+		freeze_node_list(container, &node->function_call_expr.arg_list);
+		break;
+	default:
+		break;
+	}
+}
+
+static void freeze_ast(struct compiler_state *container)
+{
+	freeze_node(container, container->main_function);
+	raviX_allocator_drop_all_allocations(&container->ptrlist_allocator);
+}
+
 /*
 ** Parse the given source 'chunk' and build an abstract
 ** syntax tree; return 0 on success / non-zero return code on
 ** failure
 */
-int raviX_parse(struct compiler_state *container, const char *buffer, size_t buflen, const char *name)
+static void parse_chunk(struct compiler_state *container, struct lexer_state *lexstate)
 {
-	struct lexer_state *lexstate = raviX_init_lexer(container, buffer, buflen, name);
 	struct parser_state parser_state;
 	parser_state_init(&parser_state, lexstate, container);
+	parse_lua_chunk(&parser_state);
+	freeze_ast(container);
+}
+
+/*
+** The lexer state is created after setjmp() so that running out of memory
+** while creating it is reported like any other error
+*/
+int raviX_parse(struct compiler_state *container, const char *buffer, size_t buflen, const char *name)
+{
+	struct lexer_state *volatile lexstate = NULL;
+	struct phase_timer timer;
+	raviX_begin_phase(container, &timer);
+	raviX_catch_memory_errors(container);
 	int rc = setjmp(container->env);
 	if (rc == 0) {
-		parse_lua_chunk(&parser_state);
+		lexstate = raviX_init_lexer(container, buffer, buflen, name);
+		parse_chunk(container, lexstate);
 	}
+	raviX_end_memory_errors(container);
 	raviX_destroy_lexer(lexstate);
+	raviX_end_phase(container, COMPILER_PHASE_PARSE, &timer);
+	return rc;
+}
+
+/*
+** Same as raviX_parse() but reads the input from a reader
+*/
+int raviX_parse_with_reader(struct compiler_state *container, raviX_Reader reader, void *reader_data,
+			    const char *name)
+{
+	struct lexer_state *volatile lexstate = NULL;
+	struct phase_timer timer;
+	raviX_begin_phase(container, &timer);
+	raviX_catch_memory_errors(container);
+	int rc = setjmp(container->env);
+	if (rc == 0) {
+		lexstate = raviX_init_lexer_with_reader(container, reader, reader_data, name);
+		parse_chunk(container, lexstate);
+	}
+	raviX_end_memory_errors(container);
+	raviX_destroy_lexer(lexstate);
+	raviX_end_phase(container, COMPILER_PHASE_PARSE, &timer);
+	return rc;
+}
+
+/*
+** Same as raviX_parse() but reads tokens from a stream
+** previously produced by raviX_lex_all()
+*/
+int raviX_parse_token_stream(struct compiler_state *container, const TokenStream *stream, const char *name)
+{
+	struct lexer_state *volatile lexstate = NULL;
+	struct phase_timer timer;
+	raviX_begin_phase(container, &timer);
+	raviX_catch_memory_errors(container);
+	int rc = setjmp(container->env);
+	if (rc == 0) {
+		lexstate = raviX_init_token_stream_lexer(container, stream, name);
+		parse_chunk(container, lexstate);
+	}
+	raviX_end_memory_errors(container);
+	raviX_destroy_lexer(lexstate);
+	raviX_end_phase(container, COMPILER_PHASE_PARSE, &timer);
 	return rc;
 }
 
 /*
 Return true if two strings are equal, false otherwise.
 */
-static int string_equal(const void *a, const void *b)
+int raviX_string_equal(const void *a, const void *b)
 {
 	const struct string_object *c1 = (const struct string_object *)a;
 	const struct string_object *c2 = (const struct string_object *)b;
@@ -1553,30 +1743,86 @@ static int string_equal(const void *a, const void *b)
 	return memcmp(c1->str, c2->str, c1->len) == 0;
 }
 
-static uint32_t string_hash(const void *c)
+uint32_t raviX_string_hash(const void *c)
 {
 	const struct string_object *c1 = (const struct string_object *)c;
 	return c1->hash;
 }
 
-struct compiler_state *raviX_init_compiler()
+void raviX_begin_phase(struct compiler_state *container, struct phase_timer *timer)
+{
+	timer->start_ns = raviX_time_ns();
+	timer->start_bytes = container->memory.bytes_requested;
+}
+
+void raviX_end_phase(struct compiler_state *container, enum compiler_phase phase, const struct phase_timer *timer)
 {
-	struct compiler_state *container = (struct compiler_state *)calloc(1, sizeof(struct compiler_state));
+	struct compiler_phase_stats *stats = &container->stats.phases[phase];
+	stats->calls++;
+	stats->nanoseconds += raviX_time_ns() - timer->start_ns;
+	stats->bytes += container->memory.bytes_requested - timer->start_bytes;
+	struct compiler_allocator_stats strings;
+	raviX_allocator_get_stats(&container->string_object_allocator, &strings);
+	if (strings.used_bytes > container->stats.peak_string_bytes)
+		container->stats.peak_string_bytes = strings.used_bytes;
+}
+
+void raviX_get_compiler_stats(const struct compiler_state *container, struct compiler_stats *stats)
+{
+	*stats = container->stats;
+	const struct allocator *allocators[COMPILER_STATE_ALLOCATORS] = {
+	    &container->ast_node_allocator, &container->ptrlist_allocator, &container->block_scope_allocator,
+	    &container->symbol_allocator, &container->string_object_allocator, &container->frozen_list_allocator};
+	for (unsigned i = 0; i < COMPILER_STATE_ALLOCATORS; i++)
+		raviX_allocator_get_stats(allocators[i], &stats->allocators[i]);
+	if (stats->allocator_count < COMPILER_STATE_ALLOCATORS)
+		stats->allocator_count = COMPILER_STATE_ALLOCATORS;
+	stats->ast_nodes = stats->allocators[0].objects;
+	stats->ptrlist_nodes += stats->allocators[1].objects;
+	stats->symbols = stats->allocators[3].objects;
+	stats->strings = stats->allocators[4].objects;
+	stats->string_bytes = stats->allocators[4].used_bytes;
+	if (stats->string_bytes > stats->peak_string_bytes)
+		stats->peak_string_bytes = stats->string_bytes;
+}
+
+struct compiler_state *raviX_init_compiler() { return raviX_init_compiler_with_allocator(NULL); }
+
+struct compiler_state *raviX_init_compiler_with_allocator(const struct memory_allocator *allocator)
+{
+	struct memory_context memory;
+	raviX_memory_init(&memory, allocator);
+	struct compiler_state *container =
+	    (struct compiler_state *)memory.hooks.alloc(memory.hooks.user_data, sizeof(struct compiler_state));
+	if (!container)
+		return NULL;
+	memset(container, 0, sizeof(struct compiler_state));
+	container->memory = memory;
+	struct memory_context *m = &container->memory;
 	raviX_allocator_init(&container->ast_node_allocator, "ast nodes", sizeof(struct ast_node), sizeof(double),
-			     sizeof(struct ast_node) * 32);
+			     sizeof(struct ast_node) * 32, m);
 	raviX_allocator_init(&container->ptrlist_allocator, "ptrlists", sizeof(struct ptr_list), sizeof(double),
-			     sizeof(struct ptr_list) * 32);
+			     sizeof(struct ptr_list) * 32, m);
 	raviX_allocator_init(&container->block_scope_allocator, "block scopes", sizeof(struct block_scope),
-			     sizeof(double), sizeof(struct block_scope) * 32);
+			     sizeof(double), sizeof(struct block_scope) * 32, m);
 	raviX_allocator_init(&container->symbol_allocator, "symbols", sizeof(struct lua_symbol), sizeof(double),
-			     sizeof(struct lua_symbol) * 64);
-	raviX_allocator_init(&container->string_allocator, "strings", 0, sizeof(double), 1024);
+			     sizeof(struct lua_symbol) * 64, m);
 	raviX_allocator_init(&container->string_object_allocator, "string_objects", sizeof(struct string_object),
-			     sizeof(double), sizeof(struct string_object) * 64);
-	raviX_buffer_init(&container->buff, 1024);
-	container->strings = set_create(string_hash, string_equal);
+			     sizeof(double), STRING_OBJECT_CHUNK, m);
+	raviX_allocator_init(&container->frozen_list_allocator, "frozen ptrlists", 0, sizeof(void *),
+			     sizeof(struct ptr_list) * 32, m);
+	container->error_message.memory = m;
+	string_set_init(&container->strings, m); /* the table is allocated when the first string is added */
+	/* the buffer below is the only allocation, if it fails there is nothing to return */
+	m->env = &container->env;
+	if (setjmp(container->env) != 0) {
+		m->env = NULL;
+		raviX_destroy_compiler(container);
+		return NULL;
+	}
+	raviX_buffer_init_with_memory(&container->buff, 1024, m);
+	m->env = NULL;
 	container->main_function = NULL;
-	container->killed = false;
 	container->linearizer = NULL;
 	return container;
 }
@@ -1587,27 +1833,117 @@ struct compiler_state *raviX_init_compiler()
 //	raviX_allocator_show_allocations(&compiler->block_scope_allocator);
 //	raviX_allocator_show_allocations(&compiler->ast_node_allocator);
 //	raviX_allocator_show_allocations(&compiler->ptrlist_allocator);
-//	raviX_allocator_show_allocations(&compiler->string_allocator);
 //	raviX_allocator_show_allocations(&compiler->string_object_allocator);
 //}
 
 void raviX_destroy_compiler(struct compiler_state *container)
 {
-	if (!container->killed) {
-		// show_allocations(container);
-		if (container->linearizer) {
-			raviX_destroy_linearizer(container->linearizer);
-			free(container->linearizer);
-		}
-		set_destroy(container->strings, NULL);
-		raviX_buffer_free(&container->buff);
-		raviX_allocator_destroy(&container->symbol_allocator);
-		raviX_allocator_destroy(&container->block_scope_allocator);
-		raviX_allocator_destroy(&container->ast_node_allocator);
-		raviX_allocator_destroy(&container->ptrlist_allocator);
-		raviX_allocator_destroy(&container->string_allocator);
-		raviX_allocator_destroy(&container->string_object_allocator);
-		container->killed = true;
+	if (!container)
+		return;
+	// show_allocations(container);
+	if (container->linearizer)
+		raviX_destroy_linearizer(container->linearizer);
+	string_set_destroy(&container->strings);
+	raviX_buffer_free(&container->buff);
+	raviX_buffer_free(&container->error_message);
+	raviX_free(&container->memory, container->lines.starts);
+	raviX_allocator_destroy(&container->symbol_allocator);
+	raviX_allocator_destroy(&container->block_scope_allocator);
+	raviX_allocator_destroy(&container->ast_node_allocator);
+	raviX_allocator_destroy(&container->ptrlist_allocator);
+	raviX_allocator_destroy(&container->string_object_allocator);
+	raviX_allocator_destroy(&container->frozen_list_allocator);
+	struct memory_allocator hooks = container->memory.hooks;
+	hooks.free(hooks.user_data, container);
+}
+
+void raviX_reset_compiler(struct compiler_state *container)
+{
+	if (container->linearizer) {
+		raviX_destroy_linearizer(container->linearizer);
+		container->linearizer = NULL;
+	}
+	/* the allocators keep their blobs and the set its table, so the next compile reuses them */
+	string_set_clear(&container->strings);
+	raviX_allocator_reset(&container->symbol_allocator);
+	raviX_allocator_reset(&container->block_scope_allocator);
+	raviX_allocator_reset(&container->ast_node_allocator);
+	raviX_allocator_reset(&container->ptrlist_allocator);
+	raviX_allocator_reset(&container->string_object_allocator);
+	raviX_allocator_reset(&container->frozen_list_allocator);
+	raviX_buffer_reset(&container->buff);
+	raviX_buffer_reset(&container->error_message);
+	if (container->error_message.buf)
+		container->error_message.buf[0] = 0;
+	container->lines.count = 0;
+	container->lines.source = NULL;
+	container->main_function = NULL;
+	container->error_handler = NULL;
+	container->interner = NULL;
+	container->zero_copy_strings = false;
+	container->memory.failed = false;
+	memset(&container->stats, 0, sizeof container->stats);
+}
+
+/*
+ * Reset compiler states waiting to be reused. The pool does not track states that are in use,
+ * those belong to whoever acquired them until they are released.
+ */
+struct compiler_pool {
+	raviX_mutex lock;
+	unsigned count;
+	unsigned max_free;
+	struct compiler_state **free_states;
+};
+
+struct compiler_pool *raviX_create_compiler_pool(unsigned max_free)
+{
+	struct compiler_pool *pool = (struct compiler_pool *)calloc(1, sizeof(struct compiler_pool));
+	if (!pool)
+		return NULL;
+	pool->free_states = (struct compiler_state **)calloc(max_free ? max_free : 1, sizeof(struct compiler_state *));
+	if (!pool->free_states) {
+		free(pool);
+		return NULL;
+	}
+	pool->max_free = max_free;
+	raviX_mutex_init(&pool->lock);
+	return pool;
+}
+
+void raviX_destroy_compiler_pool(struct compiler_pool *pool)
+{
+	if (!pool)
+		return;
+	for (unsigned i = 0; i < pool->count; i++)
+		raviX_destroy_compiler(pool->free_states[i]);
+	raviX_mutex_destroy(&pool->lock);
+	free(pool->free_states);
+	free(pool);
+}
+
+struct compiler_state *raviX_compiler_pool_acquire(struct compiler_pool *pool)
+{
+	struct compiler_state *container = NULL;
+	raviX_mutex_lock(&pool->lock);
+	if (pool->count > 0)
+		container = pool->free_states[--pool->count];
+	raviX_mutex_unlock(&pool->lock);
+	return container ? container : raviX_init_compiler();
+}
+
+void raviX_compiler_pool_release(struct compiler_pool *pool, struct compiler_state *container)
+{
+	if (!container)
+		return;
+	raviX_reset_compiler(container);
+	raviX_mutex_lock(&pool->lock);
+	if (pool->count < pool->max_free) {
+		pool->free_states[pool->count++] = container;
+		container = NULL;
 	}
+	raviX_mutex_unlock(&pool->lock);
+	if (container)
+		raviX_destroy_compiler(container);
 }
 
@@ -14,6 +14,7 @@
 
 #include <ptrlist.h>
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -42,25 +43,7 @@ void ptrlist_split_node(struct ptr_list *head)
 	memset(head->list_ + old, 0xf0, nr * sizeof(void *));
 }
 
-struct ptr_list_iter ptrlist_forward_iterator(struct ptr_list *head)
-{
-	struct ptr_list_iter iter;
-	iter.__head = iter.__list = head;
-	iter.__nr = -1;
-	return iter;
-}
-
-// Reverse iterator has to start from previous node not previous entry
-// in the given head
-struct ptr_list_iter ptrlist_reverse_iterator(struct ptr_list *head)
-{
-	struct ptr_list_iter iter;
-	iter.__head = iter.__list = head ? head->prev_ : NULL;
-	iter.__nr = iter.__head ? iter.__head->nr_ : 0;
-	return iter;
-}
-
-void *ptrlist_iter_next(struct ptr_list_iter *self)
+void *ptrlist_iter_next_slow(struct ptr_list_iter *self)
 {
 	if (self->__head == NULL)
 		return NULL;
@@ -81,7 +64,7 @@ Lretry:
 	return NULL;
 }
 
-void *ptrlist_nth_entry(struct ptr_list *list, unsigned int idx)
+void *ptrlist_nth_entry_slow(struct ptr_list *list, unsigned int idx)
 {
 	struct ptr_list *head = list;
 	if (!head)
@@ -96,7 +79,7 @@ void *ptrlist_nth_entry(struct ptr_list *list, unsigned int idx)
 	return NULL;
 }
 
-void *ptrlist_iter_prev(struct ptr_list_iter *self)
+void *ptrlist_iter_prev_slow(struct ptr_list_iter *self)
 {
 	if (self->__head == NULL)
 		return NULL;
@@ -169,7 +152,7 @@ void ptrlist_iter_mark_deleted(struct ptr_list_iter *self)
 	self->__list->rm_++;
 }
 
-int ptrlist_size(const struct ptr_list *head)
+int ptrlist_size_slow(const struct ptr_list *head)
 {
 	int nr = 0;
 	if (head) {
@@ -188,6 +171,7 @@ void **ptrlist_add(struct ptr_list **listp, void *ptr, struct allocator *alloc)
 	void **ret;
 	int nr;
 
+	assert(!list || !ptrlist_is_frozen(list));
 	if (!list || (nr = (last = list->prev_)->nr_) >= N_) {
 		struct ptr_list *newlist = (struct ptr_list *)raviX_allocator_allocate(alloc, 0);
 		newlist->allocator_ = alloc;
@@ -255,6 +239,30 @@ int ptrlist_linearize(struct ptr_list *head, void **arr, int max)
 	return nr;
 }
 
+struct ptr_list *ptrlist_freeze(struct ptr_list *head, struct allocator *alloc)
+{
+	if (ptrlist_is_frozen(head))
+		return head;
+	int nr = ptrlist_size(head);
+	struct ptr_list *frozen = (struct ptr_list *)raviX_allocator_allocate(
+	    alloc, offsetof(struct ptr_list, list_) + nr * sizeof(void *));
+	struct ptr_list *list = head;
+	int n = 0;
+	do {
+		for (int i = 0; i < list->nr_; i++) {
+			if (list->list_[i] != NULL)
+				frozen->list_[n++] = list->list_[i];
+		}
+	} while ((list = list->next_) != head);
+	assert(n == nr);
+	frozen->nr_ = n;
+	frozen->rm_ = 0;
+	frozen->prev_ = frozen;
+	frozen->next_ = frozen;
+	frozen->allocator_ = NULL;
+	return frozen;
+}
+
 /*
  * When we've walked the list and deleted entries,
  * we may need to re-pack it so that we don't have
@@ -665,9 +673,9 @@ static int test_sort()
 
 	struct allocator ptrlist_allocator;
 	raviX_allocator_init(&ptrlist_allocator, "ptrlist_nodes", sizeof(struct ptr_list), __alignof__(struct ptr_list),
-			     CHUNK);
+			     CHUNK, NULL);
 	struct allocator int_allocator;
-	raviX_allocator_init(&int_allocator, "ints", sizeof(int), __alignof__(int), CHUNK);
+	raviX_allocator_init(&int_allocator, "ints", sizeof(int), __alignof__(int), CHUNK, NULL);
 	struct ptr_list *int_list = NULL;
 
 	for (i = 0; i < N; i++) {
@@ -739,10 +747,10 @@ static int test_ptrlist_basics()
 {
 	struct allocator ptrlist_allocator;
 	raviX_allocator_init(&ptrlist_allocator, "ptrlist_nodes", sizeof(struct ptr_list), __alignof__(struct ptr_list),
-			     CHUNK);
+			     CHUNK, NULL);
 	struct allocator token_allocator;
 	raviX_allocator_init(&token_allocator, "ptr_list_tokens", sizeof(struct mytoken), __alignof__(struct mytoken),
-			     CHUNK);
+			     CHUNK, NULL);
 	struct ptr_list *token_list = NULL;
 	if (ptrlist_size(token_list) != 0)
 		return 1;
@@ -845,7 +853,7 @@ static int test_ptrlist_basics()
 
 	struct allocator mystruct_allocator;
 	raviX_allocator_init(&mystruct_allocator, "mystructs", sizeof(struct mystruct), __alignof__(struct mystruct),
-			     CHUNK);
+			     CHUNK, NULL);
 	struct ptr_list *mystruct_list = NULL;
 
 	struct mystruct *s1 = (struct mystruct *)raviX_allocator_allocate(&mystruct_allocator, 0);
@@ -38,6 +38,13 @@ extern "C" {
 * The main advantage is that it is well suited to fixed sized memory 
 * allocators as there is no resizing of memory already allocated, which happens
 * with dynamic arrays. The ptrlist is made up of fixed size nodes.
+*
+* A list that will not change again can be frozen: it is then copied into a
+* single node, sized to hold exactly its entries, whose allocator_ is NULL.
+* A frozen list is still a valid ring so the usual functions can read it,
+* but it can also be read with a plain indexed loop - FOR_EACH_FROZEN_PTR,
+* which walks a list that is not frozen the usual way.
+* Nothing can be added to or removed from a frozen list.
 */
 
 /* number of array entries per node */
@@ -48,8 +55,8 @@ extern "C" {
 /* structure of a node */
 #define DECLARE_PTR_LIST(listname, type)                                       \
 	struct listname {                                                      \
-		int nr_ : 8;                                                   \
-		int rm_ : 8;                                                   \
+		int nr_;                                                       \
+		int rm_;                                                       \
 		struct listname *prev_;                                        \
 		struct listname *next_;                                        \
 		struct allocator *allocator_;                                  \
@@ -67,9 +74,7 @@ struct ptr_list_iter {
 };
 
 /* The ptr list */
-extern int ptrlist_size(const struct ptr_list *self);
 extern void **ptrlist_add(struct ptr_list **self, void *ptr, struct allocator *ptr_list_allocator);
-extern void *ptrlist_nth_entry(struct ptr_list *list, unsigned int idx);
 extern void *ptrlist_first(struct ptr_list *list);
 extern void *ptrlist_last(struct ptr_list *list);
 extern int ptrlist_linearize(struct ptr_list *head, void **arr, int max);
@@ -84,12 +89,73 @@ extern void *ptrlist_delete_last(struct ptr_list **self);
 extern void ptrlist_concat(struct ptr_list *a, struct ptr_list **self);
 extern void ptrlist_sort(struct ptr_list **self, void *,
 			 int (*cmp)(void *, const void *, const void *));
+/* returns a frozen copy of the list allocated from an unsized allocator, the list itself is left alone */
+extern struct ptr_list *ptrlist_freeze(struct ptr_list *self, struct allocator *array_allocator);
+
+static inline int ptrlist_is_frozen(const struct ptr_list *self) { return self == NULL || self->allocator_ == NULL; }
+
+/*
+* Slow paths of the inline functions below, for lists of more than one
+* node and, when iterating, for nodes with deleted entries
+*/
+extern int ptrlist_size_slow(const struct ptr_list *self);
+extern void *ptrlist_nth_entry_slow(struct ptr_list *list, unsigned int idx);
+extern void *ptrlist_iter_next_slow(struct ptr_list_iter *self);
+extern void *ptrlist_iter_prev_slow(struct ptr_list_iter *self);
+
+/* O(1) for lists that fit in one node, which includes all frozen lists */
+static inline int ptrlist_size(const struct ptr_list *self)
+{
+	if (self == NULL)
+		return 0;
+	if (self->next_ == self)
+		return self->nr_ - self->rm_;
+	return ptrlist_size_slow(self);
+}
+
+/* O(1) for lists that fit in one node, deleted entries are not skipped */
+static inline void *ptrlist_nth_entry(struct ptr_list *list, unsigned int idx)
+{
+	if (list != NULL && list->next_ == list)
+		return idx < (unsigned int)list->nr_ ? list->list_[idx] : NULL;
+	return ptrlist_nth_entry_slow(list, idx);
+}
 
 /* iterator functions */
-extern struct ptr_list_iter ptrlist_forward_iterator(struct ptr_list *self);
-extern struct ptr_list_iter ptrlist_reverse_iterator(struct ptr_list *self);
-extern void *ptrlist_iter_next(struct ptr_list_iter *self);
-extern void *ptrlist_iter_prev(struct ptr_list_iter *self);
+static inline struct ptr_list_iter ptrlist_forward_iterator(struct ptr_list *self)
+{
+	struct ptr_list_iter iter;
+	iter.__head = iter.__list = self;
+	iter.__nr = -1;
+	return iter;
+}
+
+/* Reverse iterator has to start from previous node not previous entry in the given head */
+static inline struct ptr_list_iter ptrlist_reverse_iterator(struct ptr_list *self)
+{
+	struct ptr_list_iter iter;
+	iter.__head = iter.__list = self ? self->prev_ : NULL;
+	iter.__nr = iter.__head ? iter.__head->nr_ : 0;
+	return iter;
+}
+
+/* Fast path: the next entry is in the current node, which has no deleted entries */
+static inline void *ptrlist_iter_next(struct ptr_list_iter *self)
+{
+	struct ptr_list *list = self->__list;
+	if (list != NULL && list->rm_ == 0 && self->__nr + 1 < list->nr_)
+		return list->list_[++self->__nr];
+	return ptrlist_iter_next_slow(self);
+}
+
+static inline void *ptrlist_iter_prev(struct ptr_list_iter *self)
+{
+	struct ptr_list *list = self->__list;
+	if (list != NULL && list->rm_ == 0 && self->__nr > 0 && self->__nr - 1 < list->nr_)
+		return list->list_[--self->__nr];
+	return ptrlist_iter_prev_slow(self);
+}
+
 extern void ptrlist_iter_split_current(struct ptr_list_iter *self);
 extern void ptrlist_iter_insert(struct ptr_list_iter *self, void *newitem);
 extern void ptrlist_iter_remove(struct ptr_list_iter *self);
@@ -108,6 +174,15 @@ static inline void **ptrlist_iter_this_address(struct ptr_list_iter *self) {
 	for (var = ptrlist_iter_next(&var##iter__); var != NULL; var = ptrlist_iter_next(&var##iter__))
 #define END_FOR_EACH_PTR(var) }
 
+/* a list that is not frozen, such as those of a tree whose parse failed, is walked as by FOR_EACH_PTR */
+#define FOR_EACH_FROZEN_PTR(list, var) \
+	{ struct ptr_list *var##frozen__ = (struct ptr_list *)list; \
+	int var##nr__ = !var##frozen__ ? 0 : ptrlist_is_frozen(var##frozen__) ? var##frozen__->nr_ : -1; \
+	struct ptr_list_iter var##iter__ = ptrlist_forward_iterator(var##frozen__); \
+	for (int var##i__ = 0; var##nr__ >= 0 ? var##i__ < var##nr__ && (var = var##frozen__->list_[var##i__], 1) \
+					     : (var = ptrlist_iter_next(&var##iter__)) != NULL; var##i__++)
+#define END_FOR_EACH_FROZEN_PTR(var) }
+
 #define FOR_EACH_PTR_REVERSE(list, var) \
 	{ struct ptr_list_iter var##iter__ = ptrlist_reverse_iterator((struct ptr_list *)list); \
 	for (var = ptrlist_iter_prev(&var##iter__); var != NULL; var = ptrlist_iter_prev(&var##iter__))
@@ -14,6 +14,7 @@ b) Perform type checking (Ravi enhancement)
 #include "ravi_compiler.h"
 
 #include "allocate.h"
+#include "flat_set.h"
 #include "membuf.h"
 #include "ptrlist.h"
 #include "set.h"
@@ -29,6 +30,9 @@ b) Perform type checking (Ravi enhancement)
 #include <string.h>
 
 enum { MAXVARS = 125 };
+/* chunk size of the string object allocators, strings are stored with their header so this
+ * bounds the length of a string */
+enum { STRING_OBJECT_CHUNK = 16 * 1024 };
 #define LUA_ENV "_ENV"
 #define LUA_MAXINTEGER INT_MAX
 
@@ -41,28 +45,70 @@ struct lua_symbol_list;
 struct linearizer_state;
 struct lexer_state;
 
+/* Interned strings are looked up by their stored hash, and are equal if they have the same characters */
+static inline uint32_t string_object_hash(const struct string_object *s) { return s->hash; }
+static inline bool string_object_equal(const struct string_object *a, const struct string_object *b)
+{
+	return a->len == b->len && a->hash == b->hash && memcmp(a->str, b->str, a->len) == 0;
+}
+DECLARE_FLAT_SET(string_set, const struct string_object, string_object_hash, string_object_equal);
+
+/* Offsets at which the lines of a source start, so that offsets can be mapped to lines and columns */
+struct line_table {
+	uint32_t *starts;   /* starts[i] is the offset of line i + 1 */
+	uint32_t count;
+	uint32_t capacity;
+	const char *source; /* input buffer the table was built for, NULL if the input came from a reader */
+};
+
 /*
  * Encapsulate all the compiler state.
  * All memory is held by this object or sub-objects. Memory is freed when
  * the object is destroyed.
  */
 struct compiler_state {
+	struct memory_context memory; /* hooks for all memory owned by the compiler state */
 	struct allocator ast_node_allocator;
-	struct allocator ptrlist_allocator;
+	struct allocator ptrlist_allocator;	  /* ptrlist nodes, only used while parsing */
 	struct allocator block_scope_allocator;
 	struct allocator symbol_allocator;
-	struct allocator string_allocator;
-	struct allocator string_object_allocator;
-	struct set *strings;
+	struct allocator string_object_allocator; /* string headers, each followed by its characters */
+	struct allocator frozen_list_allocator;	  /* the syntax tree's lists, frozen once parsing is done */
+	struct string_set strings;
 	struct ast_node *main_function;
 	struct linearizer_state *linearizer;
 	int (*error_handler)(const char *fmt, ...);
 	membuff_t buff;		 /* temp storage for literals, used by the lexer and parser */
 	jmp_buf env;		 /* For error handling */
 	membuff_t error_message; /* For error handling, error message is saved here */
-	bool killed;		 /* flag to check if this is already destroyed */
+	struct string_interner *interner; /* if set strings are interned here rather than in 'strings' */
+	bool zero_copy_strings;	 /* strings that appear verbatim in the source point into it rather than being copied */
+	struct line_table lines; /* where each line of the source starts, recorded by the lexer */
+	struct compiler_stats stats; /* phases so far, and the last linearizer's allocators and objects */
 };
 
+/* the allocators above come first in compiler_stats.allocators, the linearizer's follow */
+enum { COMPILER_STATE_ALLOCATORS = 6 };
+
+/* Measures one call of a phase for raviX_get_compiler_stats() */
+struct phase_timer {
+	uint64_t start_ns;
+	uint64_t start_bytes;
+};
+void raviX_begin_phase(struct compiler_state *container, struct phase_timer *timer);
+void raviX_end_phase(struct compiler_state *container, enum compiler_phase phase, const struct phase_timer *timer);
+
+/*
+ * Allocations that fail between these two calls longjmp to container->env and are reported
+ * as "out of memory", they must bracket every setjmp(container->env)
+ */
+static inline void raviX_catch_memory_errors(struct compiler_state *container)
+{
+	container->memory.env = &container->env;
+	container->memory.failed = false;
+}
+static inline void raviX_end_memory_errors(struct compiler_state *container) { container->memory.env = NULL; }
+
 /* number of reserved words */
 #define NUM_RESERVED ((int)(TOK_WHILE - FIRST_RESERVED + 1))
 
@@ -72,16 +118,27 @@ struct lexer_state {
 	int current;	 /* current character (charint) */
 	int linenumber;	 /* input line counter */
 	int lastline;	 /* line of last token 'consumed' */
+	uint32_t lastoffset; /* offset of last token 'consumed' */
 	Token t;	 /* current token */
 	Token lookahead; /* look ahead token */
 	struct compiler_state *container;
-	const char *buf;
-	size_t bufsize;
-	size_t n;
-	const char *p;
+	const char *buf;    /* current block of input, or the whole input if there is no reader */
+	size_t bufsize;	    /* size of the current block */
+	size_t buf_offset;  /* offset of the current block from the start of input */
+	size_t n;	    /* number of characters left in the block */
+	const char *p;	    /* next character in the block */
+	raviX_Reader reader; /* if set, supplies successive blocks of input */
+	void *reader_data;
+	bool reader_done;   /* reader has signalled end of input */
 	membuff_t *buff;    /* buffer for tokens, points to the buffer in compiler_state */
 	const char *source; /* current source name */
 	const char *envn;   /* environment variable name */
+	size_t token_offset; /* offset of the first character of the last token read by llex() */
+	int token_line;	     /* line number where the last token read by llex() starts */
+	const char *span;	     /* source text of the last token if it was not saved in buff */
+	size_t span_len;
+	const TokenStream *tokens; /* if set, tokens are read from this stream rather than the input buffer */
+	uint32_t next_token;	   /* index of the next token to be read from the token stream */
 };
 
 struct ast_node;
@@ -293,6 +350,7 @@ struct function_call_expression {
 struct statement {
 	enum ast_node_type type;
 	int line_number;
+	uint32_t offset;
 };
 /* Common expression type. All expression types must have the fields in this
    type at the beginning of the struct
@@ -300,6 +358,7 @@ struct statement {
 struct expression {
 	enum ast_node_type type;
 	int line_number;
+	uint32_t offset;
 	struct base_expression common_expr;
 };
 
@@ -313,6 +372,7 @@ The ast_node must be aligned with struct expression for expressions, and with st
 struct ast_node {
 	enum ast_node_type type;
 	int line_number; /* Source line number */
+	uint32_t offset; /* Byte offset in the source */
 	union {
 		struct return_statement return_stmt; /*STMT_RETURN */
 		struct label_statement label_stmt; /* STMT_LABEL */
@@ -492,7 +552,7 @@ enum pseudo_type {
 
 /* pseudo represents a pseudo (virtual) register */
 struct pseudo {
-	unsigned type : 4, regnum : 16, freed : 1;
+	unsigned type : 4, regnum : 27, freed : 1;
 	struct instruction *insn; /* instruction that created this pseudo */
 	union {
 		struct lua_symbol *symbol;	 /* PSEUDO_SYMBOL */
@@ -552,7 +612,7 @@ struct pseudo_generator {
 
 struct constant {
 	uint8_t type;
-	uint16_t index; /* index number starting from 0 assigned to each constant - acts like a reg num */
+	uint32_t index; /* position in the chunk's constant pool, starting from 0 - acts like a reg num */
 	union {
 		lua_Integer i;
 		lua_Number n;
@@ -560,6 +620,39 @@ struct constant {
 	};
 };
 
+/*
+ * Numbers are hashed and compared by their bit patterns, so that all floats spread over the pool and
+ * 0.0 and -0.0 stay distinct. Strings are interned so they are compared by address.
+ */
+static inline uint32_t constant_hash(const struct constant *c)
+{
+	if (c->type != RAVI_TNUMINT && c->type != RAVI_TNUMFLT)
+		return c->s->hash;
+	uint64_t bits;
+	if (c->type == RAVI_TNUMINT)
+		bits = (uint64_t)c->i;
+	else
+		memcpy(&bits, &c->n, sizeof bits);
+	/* finalizer of MurmurHash3, every bit of the input affects every bit of the hash */
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdULL;
+	bits ^= bits >> 33;
+	bits *= 0xc4ceb9fe1a85ec53ULL;
+	bits ^= bits >> 33;
+	return (uint32_t)bits ^ c->type;
+}
+static inline bool constants_equal(const struct constant *a, const struct constant *b)
+{
+	if (a->type != b->type)
+		return false;
+	if (a->type == RAVI_TNUMINT)
+		return a->i == b->i;
+	if (a->type == RAVI_TNUMFLT)
+		return memcmp(&a->n, &b->n, sizeof a->n) == 0;
+	return a->s == b->s;
+}
+DECLARE_FLAT_SET(constant_set, const struct constant, constant_hash, constants_equal);
+
 /* proc is a type of cfg */
 struct proc {
 	CFG_FIELDS;
@@ -575,8 +668,6 @@ struct proc {
 	struct pseudo_generator temp_int_pseudos; /* temporaries known to be integer type */
 	struct pseudo_generator temp_flt_pseudos; /* temporaries known to be number type */
 	struct pseudo_generator temp_pseudos;	  /* All other temporaries */
-	struct set *constants;			  /* constants used by this proc */
-	unsigned num_constants;
 };
 
 static inline struct basic_block *n2bb(struct node *n) { return (struct basic_block *)n; }
@@ -596,11 +687,21 @@ struct linearizer_state {
 	struct proc_list *all_procs; /* All procs allocated by the linearizer */
 	struct proc *current_proc;   /* proc being compiled */
 	uint32_t proc_id;
+	struct pseudo_list *symbol_pseudos; /* pseudos that refer to symbols, for raviX_linearizer_release_ast() */
+	struct constant_set constants;	    /* constants of all the procs, each one once */
 };
 
 void raviX_print_ast_node(membuff_t *buf, struct ast_node *node, int level); /* output the AST structure recusrively */
 void raviX_show_linearizer(struct linearizer_state *linearizer, membuff_t *mb);
 void raviX_syntaxerror(struct lexer_state *ls, const char *msg);
+struct lexer_state *raviX_init_token_stream_lexer(struct compiler_state *compiler_state, const TokenStream *stream,
+						  const char *source_name);
 void luaX_token2str(struct lexer_state *ls, int token);
+/* Hash and equality functions for sets of string objects */
+uint32_t raviX_string_hash(const void *c);
+int raviX_string_equal(const void *a, const void *b);
+/* Interns a string in the shared interner, the hash must be that of the string */
+const struct string_object *raviX_interner_intern(struct string_interner *interner, const char *input, uint32_t len,
+						  uint32_t hash);
 
 #endif
@@ -0,0 +1,166 @@
+/*
+ * Byte scanning helpers for the lexer.
+ * The vector versions process 16 (SSE2) or 32 (AVX2) bytes per step, and hand
+ * the remaining tail to the scalar versions.
+ */
+
+#include "scan.h"
+
+#include <stdint.h>
+
+#if !defined(RAVICOMP_NO_SIMD)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCAN_SSE2 1
+#endif
+#endif
+
+#if defined(SCAN_AVX2)
+typedef __m256i vec_t;
+#define VEC_SIZE 32
+#define VEC_ALL 0xFFFFFFFFu
+#define vec_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define vec_set1(c) _mm256_set1_epi8((char)(c))
+#define vec_eq(a, b) _mm256_cmpeq_epi8(a, b)
+#define vec_or(a, b) _mm256_or_si256(a, b)
+#define vec_mask(a) ((uint32_t)_mm256_movemask_epi8(a))
+#elif defined(SCAN_SSE2)
+typedef __m128i vec_t;
+#define VEC_SIZE 16
+#define VEC_ALL 0xFFFFu
+#define vec_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define vec_set1(c) _mm_set1_epi8((char)(c))
+#define vec_eq(a, b) _mm_cmpeq_epi8(a, b)
+#define vec_or(a, b) _mm_or_si128(a, b)
+#define vec_mask(a) ((uint32_t)_mm_movemask_epi8(a))
+#endif
+
+#if defined(VEC_SIZE)
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline unsigned first_bit(uint32_t mask)
+{
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+}
+#else
+static inline unsigned first_bit(uint32_t mask) { return (unsigned)__builtin_ctz(mask); }
+#endif
+#endif
+
+static inline int is_space(int c) { return c == ' ' || c == '\t' || c == '\v' || c == '\f'; }
+
+size_t raviX_scan_spaces_scalar(const char *p, size_t n)
+{
+	size_t i = 0;
+	while (i < n && is_space(p[i]))
+		i++;
+	return i;
+}
+
+size_t raviX_scan_newline_scalar(const char *p, size_t n)
+{
+	size_t i = 0;
+	while (i < n && p[i] != '\n' && p[i] != '\r')
+		i++;
+	return i;
+}
+
+size_t raviX_scan_long_string_scalar(const char *p, size_t n)
+{
+	size_t i = 0;
+	while (i < n && p[i] != ']' && p[i] != '\n' && p[i] != '\r')
+		i++;
+	return i;
+}
+
+size_t raviX_scan_short_string_scalar(const char *p, size_t n, int del)
+{
+	size_t i = 0;
+	while (i < n && p[i] != del && p[i] != '\\' && p[i] != '\n' && p[i] != '\r')
+		i++;
+	return i;
+}
+
+#if defined(VEC_SIZE)
+
+size_t raviX_scan_spaces(const char *p, size_t n)
+{
+	const vec_t sp = vec_set1(' '), tab = vec_set1('\t'), vt = vec_set1('\v'), ff = vec_set1('\f');
+	size_t i = 0;
+	/* most runs are one or two characters long, so check those before starting the vector loop */
+	while (i < 2 && i < n && is_space(p[i]))
+		i++;
+	if (i < 2)
+		return i;
+	for (; i + VEC_SIZE <= n; i += VEC_SIZE) {
+		vec_t v = vec_load(p + i);
+		uint32_t mask = vec_mask(vec_or(vec_or(vec_eq(v, sp), vec_eq(v, tab)), vec_or(vec_eq(v, vt), vec_eq(v, ff))));
+		if (mask != VEC_ALL)
+			return i + first_bit(~mask & VEC_ALL);
+	}
+	return i + raviX_scan_spaces_scalar(p + i, n - i);
+}
+
+size_t raviX_scan_newline(const char *p, size_t n)
+{
+	const vec_t nl = vec_set1('\n'), cr = vec_set1('\r');
+	size_t i = 0;
+	for (; i + VEC_SIZE <= n; i += VEC_SIZE) {
+		vec_t v = vec_load(p + i);
+		uint32_t mask = vec_mask(vec_or(vec_eq(v, nl), vec_eq(v, cr)));
+		if (mask)
+			return i + first_bit(mask);
+	}
+	return i + raviX_scan_newline_scalar(p + i, n - i);
+}
+
+size_t raviX_scan_long_string(const char *p, size_t n)
+{
+	const vec_t nl = vec_set1('\n'), cr = vec_set1('\r'), rb = vec_set1(']');
+	size_t i = 0;
+	for (; i + VEC_SIZE <= n; i += VEC_SIZE) {
+		vec_t v = vec_load(p + i);
+		uint32_t mask = vec_mask(vec_or(vec_or(vec_eq(v, nl), vec_eq(v, cr)), vec_eq(v, rb)));
+		if (mask)
+			return i + first_bit(mask);
+	}
+	return i + raviX_scan_long_string_scalar(p + i, n - i);
+}
+
+size_t raviX_scan_short_string(const char *p, size_t n, int del)
+{
+	const vec_t nl = vec_set1('\n'), cr = vec_set1('\r'), bs = vec_set1('\\'), dl = vec_set1(del);
+	size_t i = 0;
+	for (; i + VEC_SIZE <= n; i += VEC_SIZE) {
+		vec_t v = vec_load(p + i);
+		uint32_t mask = vec_mask(vec_or(vec_or(vec_eq(v, nl), vec_eq(v, cr)), vec_or(vec_eq(v, bs), vec_eq(v, dl))));
+		if (mask)
+			return i + first_bit(mask);
+	}
+	return i + raviX_scan_short_string_scalar(p + i, n - i, del);
+}
+
+#else
+
+size_t raviX_scan_spaces(const char *p, size_t n) { return raviX_scan_spaces_scalar(p, n); }
+size_t raviX_scan_newline(const char *p, size_t n) { return raviX_scan_newline_scalar(p, n); }
+size_t raviX_scan_long_string(const char *p, size_t n) { return raviX_scan_long_string_scalar(p, n); }
+size_t raviX_scan_short_string(const char *p, size_t n, int del) { return raviX_scan_short_string_scalar(p, n, del); }
+
+#endif
+
+const char *raviX_scan_implementation(void)
+{
+#if defined(SCAN_AVX2)
+	return "avx2";
+#elif defined(SCAN_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,32 @@
+#ifndef ravicomp_SCAN_H
+#define ravicomp_SCAN_H
+
+/*
+ * Helpers used by the lexer to skip over runs of uninteresting characters.
+ * Each function looks at up to 'n' bytes starting at 'p' and returns the
+ * index of the first byte that stops the scan, or 'n' if there is none.
+ *
+ * On x86 the scans use AVX2 or SSE2 depending upon what the compiler is targeting;
+ * define RAVICOMP_NO_SIMD to force the portable scalar versions.
+ */
+
+#include <stddef.h>
+
+/* Finds the first byte that is not a horizontal space, i.e. ' ', '\t', '\v' or '\f' */
+size_t raviX_scan_spaces(const char *p, size_t n);
+/* Finds the first '\n' or '\r' */
+size_t raviX_scan_newline(const char *p, size_t n);
+/* Finds the first ']', '\n' or '\r' - the bytes of interest in a long string or comment */
+size_t raviX_scan_long_string(const char *p, size_t n);
+/* Finds the first delimiter 'del', '\\', '\n' or '\r' - the bytes of interest in a short string */
+size_t raviX_scan_short_string(const char *p, size_t n, int del);
+/* Name of the implementation in use: "avx2", "sse2" or "scalar" */
+const char *raviX_scan_implementation(void);
+
+/* The scalar versions, always available */
+size_t raviX_scan_spaces_scalar(const char *p, size_t n);
+size_t raviX_scan_newline_scalar(const char *p, size_t n);
+size_t raviX_scan_long_string_scalar(const char *p, size_t n);
+size_t raviX_scan_short_string_scalar(const char *p, size_t n, int del);
+
+#endif
@@ -33,9 +33,11 @@
  */
 
 #include "set.h"
+#include "allocate.h"
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 #define ARRAY_SIZE(array) ((int)(sizeof(array) / sizeof(array[0])))
@@ -104,13 +106,14 @@ entry_is_present(const struct set_entry *entry)
 }
 
 struct set *
-set_create(uint32_t (*hash_function)(const void *key),
+set_create(struct memory_context *memory,
+	   uint32_t (*hash_function)(const void *key),
 	   int (*key_equals_function)(const void *a,
 				   const void *b))
 {
 	struct set *set;
 
-	set = malloc(sizeof(*set));
+	set = raviX_try_calloc(memory, 1, sizeof(*set));
 	if (set == NULL)
 		return NULL;
 
@@ -120,12 +123,13 @@ set_create(uint32_t (*hash_function)(const void *key),
 	set->max_entries = hash_sizes[set->size_index].max_entries;
 	set->hash_function = hash_function;
 	set->key_equals_function = key_equals_function;
-	set->table = calloc(set->size, sizeof(*set->table));
+	set->memory = memory;
+	set->table = raviX_try_calloc(memory, set->size, sizeof(*set->table));
 	set->entries = 0;
 	set->deleted_entries = 0;
 
 	if (set->table == NULL) {
-		free(set);
+		raviX_free(memory, set);
 		return NULL;
 	}
 
@@ -151,8 +155,32 @@ set_destroy(struct set *set, void (*delete_function)(struct set_entry *entry))
 			delete_function(entry);
 		}
 	}
-	free(set->table);
-	free(set);
+	raviX_free(set->memory, set->table);
+	raviX_free(set->memory, set);
+}
+
+/**
+ * Removes all entries from the set, keeping its table so that it can be
+ * filled again without rehashing.
+ *
+ * If delete_function is passed, it gets called on each entry present.
+ */
+void
+set_clear(struct set *set, void (*delete_function)(struct set_entry *entry))
+{
+	if (!set)
+		return;
+
+	if (delete_function) {
+		struct set_entry *entry;
+
+		set_foreach(set, entry) {
+			delete_function(entry);
+		}
+	}
+	memset(set->table, 0, set->size * sizeof(*set->table));
+	set->entries = 0;
+	set->deleted_entries = 0;
 }
 
 /* Does the set contain an entry with the given key.
@@ -221,7 +249,7 @@ set_rehash(struct set *set, int new_size_index)
 	if (new_size_index >= ARRAY_SIZE(hash_sizes))
 		return;
 
-	table = calloc(hash_sizes[new_size_index].size, sizeof(*set->table));
+	table = raviX_calloc(set->memory, hash_sizes[new_size_index].size, sizeof(*set->table));
 	if (table == NULL)
 		return;
 
@@ -239,7 +267,7 @@ set_rehash(struct set *set, int new_size_index)
 		set_add_pre_hashed(set, entry->hash, entry->key);
 	}
 
-	free(old_set.table);
+	raviX_free(set->memory, old_set.table);
 }
 
 /**
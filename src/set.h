@@ -31,6 +31,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+struct memory_context;
+
 struct set_entry {
 	uint32_t hash;
 	const void *key;
@@ -46,15 +48,21 @@ struct set {
 	uint32_t size_index;
 	uint32_t entries;
 	uint32_t deleted_entries;
+	struct memory_context *memory;
 };
 
+/* memory may be NULL, the set then uses malloc */
 struct set *
-set_create(uint32_t (*hash_function)(const void *key),
+set_create(struct memory_context *memory,
+	   uint32_t (*hash_function)(const void *key),
 	   int (*key_equals_function)(const void *a,
 				      const void *b));
 void
 set_destroy(struct set *set,
 	    void (*delete_function)(struct set_entry *entry));
+void
+set_clear(struct set *set,
+	  void (*delete_function)(struct set_entry *entry));
 
 struct set_entry *
 set_add(struct set *set, const void *key);
@@ -0,0 +1,81 @@
+#include "threads.h"
+
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/* The platform thread entry points have different signatures, so the function and its argument are passed on */
+struct thread_start {
+	raviX_thread_function fn;
+	void *arg;
+};
+
+#if defined(_WIN32)
+static DWORD WINAPI thread_main(LPVOID data)
+#else
+static void *thread_main(void *data)
+#endif
+{
+	struct thread_start start = *(struct thread_start *)data;
+	free(data);
+	start.fn(start.arg);
+	return 0;
+}
+
+bool raviX_thread_start(raviX_thread *thread, raviX_thread_function fn, void *arg)
+{
+	struct thread_start *start = (struct thread_start *)malloc(sizeof *start);
+	if (!start)
+		return false;
+	start->fn = fn;
+	start->arg = arg;
+#if defined(_WIN32)
+	*thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+	if (*thread != NULL)
+		return true;
+#else
+	if (pthread_create(thread, NULL, thread_main, start) == 0)
+		return true;
+#endif
+	free(start);
+	return false;
+}
+
+void raviX_thread_join(raviX_thread *thread)
+{
+#if defined(_WIN32)
+	WaitForSingleObject(*thread, INFINITE);
+	CloseHandle(*thread);
+#else
+	pthread_join(*thread, NULL);
+#endif
+}
+
+unsigned raviX_hardware_threads(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (unsigned)info.dwNumberOfProcessors : 1;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+uint64_t raviX_time_ns(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef ravicomp_THREADS_H
+#define ravicomp_THREADS_H
+
+/*
+ * Minimal wrapper over the platform threads: POSIX threads, or Win32 threads on Windows. Also
+ * the platform's monotonic clock.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+typedef HANDLE raviX_thread;
+typedef SRWLOCK raviX_mutex;
+#else
+#include <pthread.h>
+typedef pthread_t raviX_thread;
+typedef pthread_mutex_t raviX_mutex;
+#endif
+
+typedef void (*raviX_thread_function)(void *arg);
+
+/* Starts a thread that runs fn(arg); returns false if the thread could not be created */
+bool raviX_thread_start(raviX_thread *thread, raviX_thread_function fn, void *arg);
+/* Waits for the thread to finish */
+void raviX_thread_join(raviX_thread *thread);
+/* Number of hardware threads, at least 1 */
+unsigned raviX_hardware_threads(void);
+/* Nanoseconds from a monotonic clock, for measuring elapsed time */
+uint64_t raviX_time_ns(void);
+
+#if defined(_WIN32)
+static inline void raviX_mutex_init(raviX_mutex *mutex) { InitializeSRWLock(mutex); }
+static inline void raviX_mutex_destroy(raviX_mutex *mutex) { (void)mutex; }
+static inline void raviX_mutex_lock(raviX_mutex *mutex) { AcquireSRWLockExclusive(mutex); }
+static inline void raviX_mutex_unlock(raviX_mutex *mutex) { ReleaseSRWLockExclusive(mutex); }
+#else
+static inline void raviX_mutex_init(raviX_mutex *mutex) { pthread_mutex_init(mutex, NULL); }
+static inline void raviX_mutex_destroy(raviX_mutex *mutex) { pthread_mutex_destroy(mutex); }
+static inline void raviX_mutex_lock(raviX_mutex *mutex) { pthread_mutex_lock(mutex); }
+static inline void raviX_mutex_unlock(raviX_mutex *mutex) { pthread_mutex_unlock(mutex); }
+#endif
+
+#endif
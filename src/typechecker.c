@@ -38,8 +38,8 @@ static void typecheck_ast_node(struct compiler_state *container, struct ast_node
 static void typecheck_ast_list(struct compiler_state *container, struct ast_node *function, struct ast_node_list *list)
 {
 	struct ast_node *node;
-	FOR_EACH_PTR(list, node) { typecheck_ast_node(container, function, node); }
-	END_FOR_EACH_PTR(node);
+	FOR_EACH_FROZEN_PTR(list, node) { typecheck_ast_node(container, function, node); }
+	END_FOR_EACH_FROZEN_PTR(node);
 }
 
 /* Type checker - WIP  */
@@ -199,7 +199,7 @@ static void typecheck_suffixedexpr(struct compiler_state *container, struct ast_
 	typecheck_ast_node(container, function, node->suffixed_expr.primary_expr);
 	struct ast_node *prev_node = node->suffixed_expr.primary_expr;
 	struct ast_node *this_node;
-	FOR_EACH_PTR(node->suffixed_expr.suffix_list, this_node)
+	FOR_EACH_FROZEN_PTR(node->suffixed_expr.suffix_list, this_node)
 	{
 		typecheck_ast_node(container, function, this_node);
 		if (this_node->type == EXPR_Y_INDEX) {
@@ -221,7 +221,7 @@ static void typecheck_suffixedexpr(struct compiler_state *container, struct ast_
 		}
 		prev_node = this_node;
 	}
-	END_FOR_EACH_PTR(node);
+	END_FOR_EACH_FROZEN_PTR(node);
 	copy_type(&node->suffixed_expr.type, &prev_node->common_expr.type);
 }
 
@@ -232,6 +232,7 @@ static void typecheck_var_assignment(struct compiler_state *container, struct va
 		// Any value can be assigned to type ANY
 		return;
 	const char *variable_name = var_name ? var_name->str : "unknown-TODO";
+	int variable_name_len = var_name ? (int)var_name->len : (int)strlen(variable_name);
 	struct var_type *expr_type = &expr->common_expr.type;
 
 	if (var_type->type_code == RAVI_TNUMINT) {
@@ -241,7 +242,8 @@ static void typecheck_var_assignment(struct compiler_state *container, struct va
 			/* Okay, but backend must do appropriate conversion */
 			;
 		} else if (expr_type->type_code != RAVI_TNUMINT) {
-			fprintf(stderr, "Assignment to local symbol %s is not type compatible\n", variable_name);
+			fprintf(stderr, "Assignment to local symbol %.*s is not type compatible\n", variable_name_len,
+				variable_name);
 		}
 		return;
 	}
@@ -250,13 +252,15 @@ static void typecheck_var_assignment(struct compiler_state *container, struct va
 			/* Okay, but backend must do appropriate conversion */
 			;
 		} else if (expr_type->type_code != RAVI_TNUMFLT) {
-			fprintf(stderr, "Assignment to local symbol %s is not type compatible\n", variable_name);
+			fprintf(stderr, "Assignment to local symbol %.*s is not type compatible\n", variable_name_len,
+				variable_name);
 		}
 		return;
 	}
 	// all other types must strictly match
 	if (!is_type_same(var_type, expr_type)) { // We should probably check type convert-ability here
-		fprintf(stderr, "Assignment to local symbol %s is not type compatible\n", variable_name);
+		fprintf(stderr, "Assignment to local symbol %.*s is not type compatible\n", variable_name_len,
+				variable_name);
 	}
 }
 
@@ -331,7 +335,7 @@ static void typecheck_for_num_statment(struct compiler_state *container, struct
 	struct ast_node *expr;
 	enum { I = 1, F = 2, A = 4 }; /* bits representing integer, number, any */
 	int index_type = 0;
-	FOR_EACH_PTR(node->for_stmt.expr_list, expr)
+	FOR_EACH_FROZEN_PTR(node->for_stmt.expr_list, expr)
 	{
 		switch (expr->common_expr.type.type_code) {
 		case RAVI_TNUMFLT:
@@ -347,14 +351,14 @@ static void typecheck_for_num_statment(struct compiler_state *container, struct
 		if ((index_type & A) != 0)
 			break;
 	}
-	END_FOR_EACH_PTR(expr);
+	END_FOR_EACH_FROZEN_PTR(expr);
 	if ((index_type & A) == 0) { /* not any */
 		/* for I+F we use F */
 		ravitype_t symbol_type = index_type == I ? RAVI_TNUMINT : RAVI_TNUMFLT;
 		struct lua_symbol_list *symbols = node->for_stmt.symbols;
 		struct lua_symbol *sym;
 		/* actually there will be only index variable */
-		FOR_EACH_PTR(symbols, sym)
+		FOR_EACH_FROZEN_PTR(symbols, sym)
 		{
 			if (sym->symbol_type == SYM_LOCAL) {
 				set_typecode(&sym->variable.value_type, symbol_type);
@@ -362,7 +366,7 @@ static void typecheck_for_num_statment(struct compiler_state *container, struct
 				assert(0); /* cannot happen */
 			}
 		}
-		END_FOR_EACH_PTR(sym);
+		END_FOR_EACH_FROZEN_PTR(sym);
 	}
 	typecheck_ast_list(container, function, node->for_stmt.for_statement_list);
 }
@@ -370,12 +374,12 @@ static void typecheck_for_num_statment(struct compiler_state *container, struct
 static void typecheck_if_statement(struct compiler_state *container, struct ast_node *function, struct ast_node *node)
 {
 	struct ast_node *test_then_block;
-	FOR_EACH_PTR(node->if_stmt.if_condition_list, test_then_block)
+	FOR_EACH_FROZEN_PTR(node->if_stmt.if_condition_list, test_then_block)
 	{
 		typecheck_ast_node(container, function, test_then_block->test_then_block.condition);
 		typecheck_ast_list(container, function, test_then_block->test_then_block.test_then_statement_list);
 	}
-	END_FOR_EACH_PTR(node);
+	END_FOR_EACH_FROZEN_PTR(node);
 	if (node->if_stmt.else_statement_list) {
 		typecheck_ast_list(container, function, node->if_stmt.else_statement_list);
 	}
@@ -514,9 +518,14 @@ int raviX_ast_typecheck(struct compiler_state *container)
 {
 	struct ast_node *main_function = container->main_function;
 	raviX_buffer_reset(&container->error_message);
+	struct phase_timer timer;
+	raviX_begin_phase(container, &timer);
+	raviX_catch_memory_errors(container);
 	int rc = setjmp(container->env);
 	if (rc == 0) {
 		typecheck_function(container, main_function);
 	}
+	raviX_end_memory_errors(container);
+	raviX_end_phase(container, COMPILER_PHASE_TYPECHECK, &timer);
 	return rc;
 }
@@ -10,6 +10,7 @@ $command "return 1+1"
 $command "return 1+1+1"
 $command "return 2-3/5*4"
 $command "return 4.2//5"	
+$command "return 0x1.8p1, .5, 5e-1, 0xA.8P0, 1.7976931348623157e308, 123456789012345678901234567890"
 
 $command "return 0.0"
 $command "return 0"
@@ -151,6 +152,8 @@ $command "while true do print('forever') end"
 $command "repeat print('forever') brek until true"
 $command "repeat print('forever') break until true return"
 $command "for i =1,10 do if i == 2 then break end end return"
+$command "return [["
+$command "x = 1 --[==[ unfinished"
 
 $command -f input/t013.lua
 $command -f input/t014.lua
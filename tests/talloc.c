@@ -0,0 +1,270 @@
+/* checks that compiler states created with allocation hooks send all their memory through the hooks,
+ * and that running out of memory at any allocation fails cleanly with "out of memory" */
+
+#include <ravi_compiler.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const chunks[] = {
+    "local a: integer, b: number = 1, 2.5\n"
+    "local t = { a = a, b, 'str', [[long]] }\n"
+    "return t.a + b, #t, a .. 'x'\n",
+    "local function fact(n: integer)\n"
+    "  if n <= 1 then return 1 end\n"
+    "  return n * fact(n - 1)\n"
+    "end\n"
+    "return fact(10)\n",
+    "local x = (\n", /* syntax error */
+    "local t = { 1,\n 2\n", /* syntax error naming the line of the unclosed brace */
+    "local s: string = 'hello'\n"
+    "for i = 1, 10 do s = s .. i end\n"
+    "return s\n",
+};
+
+enum { NCHUNKS = sizeof chunks / sizeof chunks[0] };
+
+/* Counts allocations and fails every allocation after the first 'limit' ones */
+struct counting_allocator {
+	pthread_mutex_t lock;
+	long allocations;
+	long limit; /* -1 for no limit */
+	long live;
+};
+
+static int take(struct counting_allocator *counter)
+{
+	pthread_mutex_lock(&counter->lock);
+	int ok = counter->limit < 0 || counter->allocations < counter->limit;
+	if (ok)
+		counter->allocations++;
+	pthread_mutex_unlock(&counter->lock);
+	return ok;
+}
+
+static void adjust_live(struct counting_allocator *counter, long delta)
+{
+	pthread_mutex_lock(&counter->lock);
+	counter->live += delta;
+	pthread_mutex_unlock(&counter->lock);
+}
+
+static void *counting_alloc(void *user_data, size_t size)
+{
+	struct counting_allocator *counter = (struct counting_allocator *)user_data;
+	if (!take(counter))
+		return NULL;
+	void *p = malloc(size);
+	if (p)
+		adjust_live(counter, 1);
+	return p;
+}
+
+static void *counting_realloc(void *user_data, void *ptr, size_t size)
+{
+	struct counting_allocator *counter = (struct counting_allocator *)user_data;
+	if (!take(counter))
+		return NULL;
+	void *p = realloc(ptr, size);
+	if (p && !ptr)
+		adjust_live(counter, 1);
+	return p;
+}
+
+static void counting_free(void *user_data, void *ptr)
+{
+	struct counting_allocator *counter = (struct counting_allocator *)user_data;
+	if (ptr)
+		adjust_live(counter, -1);
+	free(ptr);
+}
+
+static struct compiler_state *create_compiler(struct counting_allocator *counter, long limit)
+{
+	pthread_mutex_init(&counter->lock, NULL);
+	counter->allocations = 0;
+	counter->limit = limit;
+	counter->live = 0;
+	struct memory_allocator allocator = {counting_alloc, counting_realloc, counting_free, counter};
+	return raviX_init_compiler_with_allocator(&allocator);
+}
+
+static int finish(struct counting_allocator *counter, const char *what, long limit)
+{
+	pthread_mutex_destroy(&counter->lock);
+	if (counter->live != 0) {
+		fprintf(stderr, "%s leaked %ld allocations with a limit of %ld\n", what, counter->live, limit);
+		return 1;
+	}
+	return 0;
+}
+
+/* Compiles the chunk and returns the printed syntax tree and linearized code, or the error. The
+ * syntax tree is released before the linearized code is printed. */
+static char *compile(struct compiler_state *container, const char *code)
+{
+	FILE *fp = tmpfile();
+	if (!fp)
+		return NULL;
+	int rc = raviX_parse(container, code, strlen(code), "input");
+	if (rc == 0)
+		rc = raviX_ast_typecheck(container);
+	if (rc == 0)
+		rc = raviX_output_ast(container, fp);
+	if (rc == 0) {
+		struct linearizer_state *linearizer = raviX_init_linearizer(container);
+		rc = linearizer ? raviX_ast_linearize(linearizer) : 1;
+		if (rc == 0)
+			rc = raviX_linearizer_release_ast(linearizer);
+		if (rc == 0)
+			rc = raviX_output_linearizer(linearizer, fp);
+		raviX_destroy_linearizer(linearizer);
+	}
+	if (rc != 0)
+		fprintf(fp, "error: %s\n", raviX_get_last_error(container));
+	long size = ftell(fp);
+	char *result = (char *)calloc(1, (size_t)size + 1);
+	rewind(fp);
+	if (fread(result, 1, (size_t)size, fp) != (size_t)size) {
+		free(result);
+		result = NULL;
+	}
+	fclose(fp);
+	return result;
+}
+
+/* Output of a compile that ran out of memory ends with the error; earlier output is allowed */
+static int out_of_memory(const char *output)
+{
+	static const char error[] = "error: out of memory\n";
+	size_t len = strlen(output);
+	return len >= sizeof error - 1 && strcmp(output + len - (sizeof error - 1), error) == 0;
+}
+
+static int check_compile(int chunk, const char *expected)
+{
+	struct counting_allocator counter;
+	struct compiler_state *container = create_compiler(&counter, -1);
+	char *actual = compile(container, chunks[chunk]);
+	raviX_destroy_compiler(container);
+	long needed = counter.allocations;
+	int rc = finish(&counter, "compile", -1);
+	if (!actual || strcmp(actual, expected) != 0) {
+		fprintf(stderr, "chunk %d differs with allocation hooks\n", chunk);
+		rc = 1;
+	}
+	free(actual);
+	for (long limit = 0; limit < needed && rc == 0; limit++) {
+		container = create_compiler(&counter, limit);
+		if (container) {
+			actual = compile(container, chunks[chunk]);
+			if (!actual || (strcmp(actual, expected) != 0 && !out_of_memory(actual))) {
+				fprintf(stderr, "chunk %d gave '%s' with a limit of %ld\n", chunk, actual ? actual : "",
+					limit);
+				rc = 1;
+			}
+			free(actual);
+			raviX_destroy_compiler(container);
+		}
+		rc |= finish(&counter, "compile", limit);
+	}
+	return rc;
+}
+
+/* Batch and parallel lexing, the token stream arrays also come from the hooks */
+static int check_lex(const char *code, unsigned threads)
+{
+	int rc = 0;
+	long needed = -1;
+	for (long limit = -1; limit < needed || limit == -1; limit++) {
+		struct counting_allocator counter;
+		struct compiler_state *container = create_compiler(&counter, limit);
+		if (container) {
+			TokenStream stream;
+			memset(&stream, 0, sizeof stream);
+			int status = threads ? raviX_lex_all_parallel(container, code, strlen(code), "input", &stream,
+								      threads, 64)
+					     : raviX_lex_all(container, code, strlen(code), "input", &stream);
+			if (status != 0 && (limit < 0 || strcmp(raviX_get_last_error(container), "out of memory") != 0)) {
+				fprintf(stderr, "lexing failed with '%s' and a limit of %ld\n",
+					raviX_get_last_error(container), limit);
+				rc = 1;
+			}
+			raviX_destroy_token_stream(&stream);
+			raviX_destroy_compiler(container);
+		}
+		if (limit == -1)
+			needed = counter.allocations;
+		rc |= finish(&counter, "lexing", limit);
+		if (rc)
+			break;
+	}
+	return rc;
+}
+
+/* A string much bigger than a chunk and a function with thousands of blocks use the large object path */
+static int check_large(void)
+{
+	enum { STRING_SIZE = 100000, BLOCKS = 2000 };
+	static const char statement[] = "if x then x = x + 1 end\n";
+	char *code = (char *)malloc(STRING_SIZE + BLOCKS * sizeof statement + 100);
+	char *p = code;
+	p += sprintf(p, "local x = 0\nlocal s = '");
+	memset(p, 'a', STRING_SIZE);
+	p += STRING_SIZE;
+	p += sprintf(p, "'\n");
+	for (int i = 0; i < BLOCKS; i++)
+		p += sprintf(p, "%s", statement);
+	sprintf(p, "return s, x\n");
+	struct counting_allocator counter;
+	struct compiler_state *container = create_compiler(&counter, -1);
+	char *actual = compile(container, code);
+	int rc = 0;
+	if (!actual || strstr(actual, "error: ") != NULL) {
+		fprintf(stderr, "large chunk failed: %s\n", actual ? actual : "");
+		rc = 1;
+	}
+	free(actual);
+	raviX_reset_compiler(container);
+	actual = compile(container, code);
+	if (!actual || strstr(actual, "error: ") != NULL) {
+		fprintf(stderr, "large chunk failed after reset\n");
+		rc = 1;
+	}
+	free(actual);
+	raviX_destroy_compiler(container);
+	rc |= finish(&counter, "large chunk", -1);
+	free(code);
+	return rc;
+}
+
+int main(void)
+{
+	int rc = 0;
+	for (int i = 0; i < NCHUNKS && rc == 0; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		char *expected = compile(container, chunks[i]);
+		raviX_destroy_compiler(container);
+		rc = expected ? check_compile(i, expected) : 1;
+		free(expected);
+	}
+	size_t len = 0;
+	for (int i = 0; i < NCHUNKS; i++)
+		len += strlen(chunks[i]);
+	char *code = (char *)malloc(len * 20 + 1);
+	code[0] = 0;
+	for (int n = 0; n < 20; n++)
+		for (int i = 0; i < NCHUNKS; i++)
+			if (i != 2)
+				strcat(code, chunks[i]);
+	if (rc == 0)
+		rc = check_lex(code, 0);
+	if (rc == 0)
+		rc = check_lex(code, 3);
+	free(code);
+	if (rc == 0)
+		rc = check_large();
+	return rc;
+}
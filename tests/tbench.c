@@ -0,0 +1,739 @@
+/* simple benchmarks for the front end */
+
+#include "ravi_compiler.h"
+#include "fnv_hash.h"
+#include "ravi_ast.h"
+#include "scan.h"
+#include "set.h"
+#include "tcommon.h"
+#include "threads.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+static double now(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+enum { SOURCE_CODE, SOURCE_COMMENTS, SOURCE_IDENTIFIERS, SOURCE_NUMERALS };
+
+/* Generates a chunk of Lua code of roughly the requested size. The style says whether it should
+ * exercise most token types, be mostly comment banners and indentation, mostly identifiers, or mostly numerals */
+static char *generate_source(size_t size, int style)
+{
+	static const char *const fragments[] = {
+	    "local function fn%d(a: integer, b: number)\n"
+	    "\tlocal t: table = { x = a, y = b, 'str', \"another\\tstring\", [[long string]] }\n"
+	    "\t-- a short comment\n"
+	    "\tfor i = 1, 100 do t[i] = i * 2.5e3 + 0x1f // 3 end\n"
+	    "\tif a >= b and not (a ~= b) or a <= 10 then return a << 2, b >> 1 end\n"
+	    "\t--[[ a long\n\tcomment ]]\n"
+	    "\twhile a > 0 do a = a - 1; goto continue_%d; ::continue_%d:: end\n"
+	    "\treturn t, #t, a .. 'x' .. \"y\"\n"
+	    "end\n",
+	    "--------------------------------------------------------------------------------\n"
+	    "-- Function fn%d, generated code follows\n"
+	    "--------------------------------------------------------------------------------\n"
+	    "--[==[\n"
+	    "    Parameters:\n"
+	    "        a   an integer value that is counted down\n"
+	    "        b   a number, returned as is [unused]\n"
+	    "]==]\n"
+	    "local function fn%d(a: integer, b: number)\n"
+	    "                                        -- loop until done\n"
+	    "        while a > 0 do\n"
+	    "                        a = a - 1        -- decrement\n"
+	    "        end\n"
+	    "        return b                         -- fn%d\n"
+	    "end\n",
+	    "do\n"
+	    "  local alpha_%d, beta_value_%d, gamma_%d = first_name, second_name, third_name\n"
+	    "  some_table.field_name.another_field = alpha_%d + beta_value_%d * gamma_%d\n"
+	    "  print(some_table, alpha_%d, math.floor(beta_value_%d), string.format(gamma_%d))\n"
+	    "end\n",
+	    "values_%d = { %d, 3.14159265358979, 6.02214076e23, 0x1F, 1.5e-10, 42, 0.5, 123456.789,\n"
+	    "\t2.718281828459045, 1e100, 0x1.8p3, 65535, 0.1, 0.2, 0.30000000000000004, 1.7976931348623157e308 }\n",
+	};
+	char *buf = (char *)malloc(size + 1024);
+	size_t pos = 0;
+	int n = 0;
+	while (pos < size) {
+		int len = snprintf(buf + pos, 1024, fragments[style], n, n, n, n, n, n, n, n, n);
+		pos += (size_t)len;
+		n++;
+	}
+	buf[pos] = 0;
+	return buf;
+}
+
+/* Tokenizes the input using the pull api, i.e. one token at a time */
+static size_t lex_pull(const char *code, size_t len)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	struct lexer_state *ls = raviX_init_lexer(container, code, len, "input");
+	const LexState *info = raviX_get_lexer_info(ls);
+	size_t count = 0;
+	do {
+		raviX_next(ls);
+		count++;
+	} while (info->t.token != TOK_EOS);
+	raviX_destroy_lexer(ls);
+	raviX_destroy_compiler(container);
+	return count;
+}
+
+/* Tokenizes the input in one go */
+static size_t lex_batch(const char *code, size_t len, TokenStream *stream)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	size_t count = 0;
+	if (raviX_lex_all(container, code, len, "input", stream) != 0)
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+	else
+		count = stream->count;
+	raviX_destroy_compiler(container);
+	return count;
+}
+
+static void bench_lex(const char *code, size_t len, int iterations)
+{
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	size_t count = 0;
+	double t0 = now();
+	for (int i = 0; i < iterations; i++)
+		count = lex_pull(code, len);
+	double t1 = now();
+	for (int i = 0; i < iterations; i++)
+		count = lex_batch(code, len, &stream);
+	double t2 = now();
+	printf("%zu bytes, %zu tokens, %d iterations\n", len, count, iterations);
+	printf("pull:  %8.3f s  %12.0f tokens/sec\n", t1 - t0, (double)count * iterations / (t1 - t0));
+	printf("batch: %8.3f s  %12.0f tokens/sec\n", t2 - t1, (double)count * iterations / (t2 - t1));
+	raviX_destroy_token_stream(&stream);
+}
+
+/* Times the scanning routines used by the lexer, scalar vs vectorized */
+static void bench_scan(const char *code, size_t len, int iterations)
+{
+	static const char *const names[] = {"spaces", "newline", "long string", "short string"};
+	printf("%zu bytes, %d iterations, using %s\n", len, iterations, raviX_scan_implementation());
+	for (int kind = 0; kind < 4; kind++) {
+		double t[2];
+		size_t stops[2];
+		for (int simd = 0; simd < 2; simd++) {
+			size_t count = 0;
+			double t0 = now();
+			for (int i = 0; i < iterations; i++) {
+				/* visit each byte that stops the scan, like the lexer would */
+				for (size_t pos = 0; pos < len; pos++, count++) {
+					const char *p = code + pos;
+					size_t n = len - pos;
+					switch (kind) {
+					case 0:
+						/* the lexer only skips spaces when it sees one */
+						if (*p == ' ')
+							pos += simd ? raviX_scan_spaces(p, n) : raviX_scan_spaces_scalar(p, n);
+						break;
+					case 1:
+						pos += simd ? raviX_scan_newline(p, n) : raviX_scan_newline_scalar(p, n);
+						break;
+					case 2:
+						pos += simd ? raviX_scan_long_string(p, n) : raviX_scan_long_string_scalar(p, n);
+						break;
+					default:
+						pos += simd ? raviX_scan_short_string(p, n, '"')
+							    : raviX_scan_short_string_scalar(p, n, '"');
+						break;
+					}
+				}
+			}
+			t[simd] = now() - t0;
+			stops[simd] = count / iterations;
+		}
+		if (stops[0] != stops[1])
+			fprintf(stderr, "Mismatch in %s scan: %zu vs %zu\n", names[kind], stops[0], stops[1]);
+		printf("%-12s %8zu stops  scalar: %8.2f MB/sec  vector: %8.2f MB/sec\n", names[kind], stops[0],
+		       (double)len * iterations / t[0] / 1e6, (double)len * iterations / t[1] / 1e6);
+	}
+}
+
+/* Times each phase of the front end separately */
+static void bench_phases(const char *code, size_t len, int iterations)
+{
+	static const char *const names[] = {"lex", "parse", "typecheck", "linearize"};
+	double t[4] = {0.0, 0.0, 0.0, 0.0};
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	for (int i = 0; i < iterations; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		double t0 = now();
+		int rc = raviX_lex_all(container, code, len, "input", &stream);
+		double t1 = now();
+		if (rc == 0)
+			rc = raviX_parse_token_stream(container, &stream, "input");
+		double t2 = now();
+		if (rc == 0)
+			rc = raviX_ast_typecheck(container);
+		double t3 = now();
+		struct linearizer_state *linearizer = NULL;
+		if (rc == 0) {
+			linearizer = raviX_init_linearizer(container);
+			rc = raviX_ast_linearize(linearizer);
+		}
+		double t4 = now();
+		if (rc != 0) {
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+			if (linearizer)
+				raviX_destroy_linearizer(linearizer);
+			raviX_destroy_compiler(container);
+			break;
+		}
+		t[0] += t1 - t0;
+		t[1] += t2 - t1;
+		t[2] += t3 - t2;
+		t[3] += t4 - t3;
+		raviX_destroy_linearizer(linearizer);
+		raviX_destroy_compiler(container);
+	}
+	printf("%zu bytes, %zu tokens, %d iterations\n", len, (size_t)stream.count, iterations);
+	for (int i = 0; i < 4; i++)
+		printf("%-10s %8.3f s  %8.2f MB/sec\n", names[i], t[i], (double)len * iterations / t[i] / 1e6);
+	raviX_destroy_token_stream(&stream);
+}
+
+/* Times raviX_lex_all() against raviX_lex_all_parallel() */
+static void bench_parallel(const char *code, size_t len, int iterations, unsigned threads)
+{
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	int rc = 0;
+	double t0 = now();
+	for (int i = 0; i < iterations && rc == 0; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		rc = raviX_lex_all(container, code, len, "input", &stream);
+		raviX_destroy_compiler(container);
+	}
+	double t1 = now();
+	for (int i = 0; i < iterations && rc == 0; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		rc = raviX_lex_all_parallel(container, code, len, "input", &stream, threads, 0);
+		if (rc != 0)
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+	}
+	double t2 = now();
+	printf("%zu bytes, %zu tokens, %d iterations, %u threads\n", len, (size_t)stream.count, iterations, threads);
+	printf("sequential: %8.3f s  %8.2f MB/sec\n", t1 - t0, (double)len * iterations / (t1 - t0) / 1e6);
+	printf("parallel:   %8.3f s  %8.2f MB/sec\n", t2 - t1, (double)len * iterations / (t2 - t1) / 1e6);
+	raviX_destroy_token_stream(&stream);
+}
+
+static int compare_pointers(const void *a, const void *b)
+{
+	const void *p = *(const void *const *)a, *q = *(const void *const *)b;
+	return p < q ? -1 : p > q;
+}
+
+static int compare_hashes(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static int string_objects_equal(const void *a, const void *b)
+{
+	const struct string_object *s = (const struct string_object *)a, *t = (const struct string_object *)b;
+	return s->len == t->len && memcmp(s->str, t->str, s->len) == 0;
+}
+
+/* Average number of slots looked at to find each key, following the probe sequence in set.c */
+static double average_probes(const struct set *set)
+{
+	uint64_t probes = 0;
+	for (uint32_t i = 0; i < set->size; i++) {
+		const struct set_entry *entry = &set->table[i];
+		if (entry->key == NULL || entry->key == set->table) /* free or deleted */
+			continue;
+		uint32_t address = entry->hash % set->size;
+		uint32_t step = 1 + entry->hash % set->rehash;
+		for (probes++; address != i; probes++)
+			address = (address + step) % set->size;
+	}
+	return (double)probes / set->entries;
+}
+
+/* Compares FNV-1a and wyhash on the identifiers in the input: hashing speed, and the probe lengths of a set of them */
+static void bench_hash(const char *code, size_t len, int iterations)
+{
+	static const char *const names[] = {"fnv-1a", "wyhash"};
+	static uint32_t (*const functions[])(const void *, size_t) = {fnv1_hash_data, wyhash_data};
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	struct compiler_state *container = raviX_init_compiler();
+	if (raviX_lex_all(container, code, len, "input", &stream) != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+		return;
+	}
+	const struct string_object **ids = (const struct string_object **)malloc(stream.count * sizeof ids[0]);
+	uint32_t count = 0;
+	size_t bytes = 0;
+	for (uint32_t i = 0; i < stream.count; i++) {
+		if (stream.token[i] == TOK_NAME) {
+			ids[count++] = stream.seminfo[i].ts;
+			bytes += stream.seminfo[i].ts->len;
+		}
+	}
+	/* the distinct identifiers, as they are interned */
+	const struct string_object **unique = (const struct string_object **)malloc(count * sizeof unique[0]);
+	memcpy(unique, ids, count * sizeof unique[0]);
+	qsort(unique, count, sizeof unique[0], compare_pointers);
+	uint32_t nunique = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		if (nunique == 0 || unique[nunique - 1] != unique[i])
+			unique[nunique++] = unique[i];
+	}
+	printf("%u identifiers, %u distinct, average length %.1f, %d iterations\n", count, nunique,
+	       count ? (double)bytes / count : 0.0, iterations);
+	for (int f = 0; f < 2; f++) {
+		volatile uint32_t sink = 0;
+		double t0 = now();
+		for (int n = 0; n < iterations; n++) {
+			for (uint32_t i = 0; i < count; i++)
+				sink += functions[f](ids[i]->str, ids[i]->len);
+		}
+		double t = now() - t0;
+		struct set *set = set_create(NULL, NULL, string_objects_equal);
+		uint32_t *hashes = (uint32_t *)malloc((nunique + 1) * sizeof hashes[0]);
+		for (uint32_t i = 0; i < nunique; i++) {
+			hashes[i] = functions[f](unique[i]->str, unique[i]->len);
+			set_add_pre_hashed(set, hashes[i], unique[i]);
+		}
+		/* distinct identifiers with the same hash value */
+		qsort(hashes, nunique, sizeof hashes[0], compare_hashes);
+		uint32_t collisions = 0;
+		for (uint32_t i = 1; i < nunique; i++)
+			collisions += hashes[i] == hashes[i - 1];
+		free(hashes);
+		printf("%-8s %8.2f M hashes/sec  %8.2f MB/sec  average probes %.3f  collisions %u\n", names[f],
+		       (double)count * iterations / t / 1e6, (double)bytes * iterations / t / 1e6, average_probes(set),
+		       collisions);
+		set_destroy(set, NULL);
+	}
+	free(unique);
+	free(ids);
+	raviX_destroy_token_stream(&stream);
+	raviX_destroy_compiler(container);
+}
+
+/* Interns the identifiers in the input as the lexer does, looking each one up and adding it if it is new: in a
+ * set.c set, in a string_set, and in a string_set reserved for all the distinct identifiers up front */
+static void bench_sets(const char *code, size_t len, int iterations)
+{
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	struct compiler_state *container = raviX_init_compiler();
+	if (raviX_lex_all(container, code, len, "input", &stream) != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+		return;
+	}
+	/* copies of the interned strings, so that finding one compares the characters */
+	struct string_object *keys = (struct string_object *)malloc(stream.count * sizeof keys[0]);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < stream.count; i++) {
+		if (stream.token[i] == TOK_NAME)
+			keys[count++] = *stream.seminfo[i].ts;
+	}
+	uint32_t distinct = 0;
+	double t[3];
+	for (int kind = 0; kind < 3; kind++) {
+		double t0 = now();
+		for (int n = 0; n < iterations; n++) {
+			distinct = 0;
+			if (kind == 0) {
+				struct set *set = set_create(NULL, raviX_string_hash, raviX_string_equal);
+				for (uint32_t i = 0; i < count; i++) {
+					if (!set_search_pre_hashed(set, keys[i].hash, &keys[i])) {
+						set_add_pre_hashed(set, keys[i].hash, &keys[i]);
+						distinct++;
+					}
+				}
+				set_destroy(set, NULL);
+			} else {
+				struct string_set set;
+				string_set_init(&set, NULL);
+				if (kind == 2)
+					string_set_reserve(&set, container->strings.count);
+				for (uint32_t i = 0; i < count; i++) {
+					if (!string_set_find(&set, keys[i].hash, &keys[i])) {
+						string_set_insert(&set, keys[i].hash, &keys[i]);
+						distinct++;
+					}
+				}
+				string_set_destroy(&set);
+			}
+		}
+		t[kind] = now() - t0;
+	}
+	printf("%u identifiers, %u distinct, %d iterations\n", count, distinct, iterations);
+	static const char *const names[] = {"set.c", "string_set", "reserved"};
+	for (int kind = 0; kind < 3; kind++)
+		printf("%-10s %8.3f s  %8.2f M lookups/sec\n", names[kind], t[kind], (double)count * iterations / t[kind] / 1e6);
+	free(keys);
+	raviX_destroy_token_stream(&stream);
+	raviX_destroy_compiler(container);
+}
+
+struct intern_job {
+	const char *code;
+	const TokenStream *names; /* the identifiers to intern */
+	struct string_interner *interner;
+	int iterations;
+};
+
+/* Interns the identifiers in a fresh compiler state each iteration, as when compiling many modules */
+static void intern_names(void *arg)
+{
+	struct intern_job *job = (struct intern_job *)arg;
+	for (int i = 0; i < job->iterations; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		raviX_set_string_interner(container, job->interner);
+		for (uint32_t j = 0; j < job->names->count; j++)
+			raviX_create_string(container, job->code + job->names->offset[j], job->names->length[j]);
+		raviX_destroy_compiler(container);
+	}
+}
+
+/* Times interning on many threads at once, each compiler state with its own strings vs a shared interner */
+static void bench_intern(const char *code, size_t len, int iterations, unsigned threads)
+{
+	if (threads == 0)
+		threads = 16;
+	TokenStream stream, names;
+	memset(&stream, 0, sizeof stream);
+	memset(&names, 0, sizeof names);
+	struct compiler_state *container = raviX_init_compiler();
+	if (raviX_lex_all(container, code, len, "input", &stream) != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+		return;
+	}
+	names.offset = (uint32_t *)malloc(stream.count * sizeof(uint32_t));
+	names.length = (uint32_t *)malloc(stream.count * sizeof(uint32_t));
+	for (uint32_t i = 0; i < stream.count; i++) {
+		if (stream.token[i] == TOK_NAME) {
+			names.offset[names.count] = stream.offset[i];
+			names.length[names.count++] = stream.length[i];
+		}
+	}
+	raviX_destroy_compiler(container);
+	raviX_thread *thread = (raviX_thread *)calloc(threads, sizeof(raviX_thread));
+	double t[2];
+	for (int shared = 0; shared < 2; shared++) {
+		struct intern_job job = {code, &names, shared ? raviX_create_string_interner() : NULL, iterations};
+		double t0 = now();
+		for (unsigned i = 0; i < threads; i++) {
+			if (!raviX_thread_start(&thread[i], intern_names, &job)) {
+				fprintf(stderr, "Failed to start thread\n");
+				exit(1);
+			}
+		}
+		for (unsigned i = 0; i < threads; i++)
+			raviX_thread_join(&thread[i]);
+		t[shared] = now() - t0;
+		raviX_destroy_string_interner(job.interner);
+	}
+	double total = (double)names.count * iterations * threads;
+	printf("%zu bytes, %u identifiers, %d iterations, %u threads\n", len, names.count, iterations, threads);
+	printf("private: %8.3f s  %8.2f M strings/sec\n", t[0], total / t[0] / 1e6);
+	printf("shared:  %8.3f s  %8.2f M strings/sec\n", t[1], total / t[1] / 1e6);
+	free(thread);
+	free(names.offset); /* filled in here rather than by the lexer */
+	free(names.length);
+	raviX_destroy_token_stream(&stream);
+}
+
+/* Times re-lexing after a small edit against lexing the whole input again */
+static void bench_relex(const char *code, size_t len, int iterations)
+{
+	/* alternately insert and remove a space in the middle of the input */
+	char *edited = (char *)malloc(len + 2);
+	size_t edit_offset = len / 2;
+	memcpy(edited, code, edit_offset);
+	edited[edit_offset] = ' ';
+	memcpy(edited + edit_offset + 1, code + edit_offset, len - edit_offset + 1);
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	struct compiler_state *container = raviX_init_compiler();
+	int rc = raviX_lex_all(container, code, len, "input", &stream);
+	double t0 = now();
+	for (int i = 0; i < iterations * 100 && rc == 0; i++) {
+		if (i % 2 == 0)
+			rc = raviX_relex(container, &stream, edited, len + 1, edit_offset, 0, 1, "input");
+		else
+			rc = raviX_relex(container, &stream, code, len, edit_offset, 1, 0, "input");
+	}
+	double t1 = now();
+	if (rc != 0)
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+	raviX_destroy_compiler(container);
+	for (int i = 0; i < iterations && rc == 0; i++) {
+		container = raviX_init_compiler();
+		rc = raviX_lex_all(container, edited, len + 1, "input", &stream);
+		raviX_destroy_compiler(container);
+	}
+	double t2 = now();
+	printf("%zu bytes, %zu tokens, %d iterations\n", len, (size_t)stream.count, iterations);
+	printf("relex:   %10.3f us per edit\n", (t1 - t0) / (iterations * 100) * 1e6);
+	printf("lex all: %10.3f us per edit\n", (t2 - t1) / iterations * 1e6);
+	raviX_destroy_token_stream(&stream);
+	free(edited);
+}
+
+static void bench_parse(const char *code, size_t len, int iterations)
+{
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	int rc = 0;
+	double t0 = now();
+	for (int i = 0; i < iterations && rc == 0; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		rc = raviX_parse(container, code, len, "input");
+		if (rc != 0)
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+	}
+	double t1 = now();
+	for (int i = 0; i < iterations && rc == 0; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		rc = raviX_lex_all(container, code, len, "input", &stream);
+		if (rc == 0)
+			rc = raviX_parse_token_stream(container, &stream, "input");
+		if (rc != 0)
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+	}
+	double t2 = now();
+	printf("%zu bytes, %d iterations\n", len, iterations);
+	printf("parse:            %8.3f s  %8.2f MB/sec\n", t1 - t0, (double)len * iterations / (t1 - t0) / 1e6);
+	printf("lex all + parse:  %8.3f s  %8.2f MB/sec\n", t2 - t1, (double)len * iterations / (t2 - t1) / 1e6);
+	raviX_destroy_token_stream(&stream);
+}
+
+/* peak resident set size in KB, 0 where not supported */
+static long peak_rss(void)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+#else
+	return 0;
+#endif
+}
+
+/* Compiles many small chunks through to the linearizer, keeping them all alive as an editor or
+ * a module loader would, and reports the time taken and how much the peak RSS grew. With
+ * release_ast only the linear IR is kept. */
+static void bench_chunks(const char *code, size_t len, int iterations, int release_ast)
+{
+	struct compiler_state **containers = (struct compiler_state **)calloc(iterations, sizeof(struct compiler_state *));
+	struct linearizer_state **linearizers =
+	    (struct linearizer_state **)calloc(iterations, sizeof(struct linearizer_state *));
+	long rss0 = peak_rss();
+	double t0 = now();
+	int n = 0;
+	for (; n < iterations; n++) {
+		struct compiler_state *container = raviX_init_compiler();
+		containers[n] = container;
+		int rc = raviX_parse(container, code, len, "input");
+		if (rc == 0)
+			rc = raviX_ast_typecheck(container);
+		if (rc == 0) {
+			linearizers[n] = raviX_init_linearizer(container);
+			rc = raviX_ast_linearize(linearizers[n]);
+			if (rc == 0 && release_ast)
+				rc = raviX_linearizer_release_ast(linearizers[n]);
+		}
+		if (rc != 0) {
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+			n++;
+			break;
+		}
+	}
+	double t1 = now();
+	long rss1 = peak_rss();
+	for (int i = 0; i < n; i++) {
+		if (linearizers[i])
+			raviX_destroy_linearizer(linearizers[i]);
+		raviX_destroy_compiler(containers[i]);
+	}
+	double t2 = now();
+	printf("%zu bytes, %d chunks\n", len, n);
+	printf("compile:  %8.3f s  %8.2f us/chunk\n", t1 - t0, (t1 - t0) / n * 1e6);
+	printf("destroy:  %8.3f s  %8.2f us/chunk\n", t2 - t1, (t2 - t1) / n * 1e6);
+	printf("peak rss grew by %ld KB, %.1f KB/chunk\n", rss1 - rss0, (double)(rss1 - rss0) / n);
+	free(linearizers);
+	free(containers);
+}
+
+/* Compiles the same chunk with a new compiler state each time, and with states recycled through a pool */
+static void bench_pool(const char *code, size_t len, int iterations)
+{
+	int rc = 0;
+	double t0 = now();
+	for (int i = 0; i < iterations && rc == 0; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		rc = raviX_parse(container, code, len, "input");
+		if (rc == 0)
+			rc = raviX_ast_typecheck(container);
+		if (rc != 0)
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+	}
+	double t1 = now();
+	struct compiler_pool *pool = raviX_create_compiler_pool(1);
+	for (int i = 0; i < iterations && rc == 0; i++) {
+		struct compiler_state *container = raviX_compiler_pool_acquire(pool);
+		rc = raviX_parse(container, code, len, "input");
+		if (rc == 0)
+			rc = raviX_ast_typecheck(container);
+		if (rc != 0)
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		raviX_compiler_pool_release(pool, container);
+	}
+	double t2 = now();
+	raviX_destroy_compiler_pool(pool);
+	printf("%zu bytes, %d iterations\n", len, iterations);
+	printf("init/destroy: %8.3f s  %8.2f us/chunk\n", t1 - t0, (t1 - t0) / iterations * 1e6);
+	printf("pool:         %8.3f s  %8.2f us/chunk\n", t2 - t1, (t2 - t1) / iterations * 1e6);
+}
+
+static void count_bytes(void *data, const char *bytes, size_t size)
+{
+	(void)bytes;
+	*(size_t *)data += size;
+}
+
+/* Times writing out the AST and the linear IR; the output is counted and discarded */
+static void bench_dump(const char *code, size_t len, int iterations)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	struct linearizer_state *linearizer = NULL;
+	int rc = raviX_parse(container, code, len, "input");
+	if (rc == 0)
+		rc = raviX_ast_typecheck(container);
+	if (rc == 0) {
+		linearizer = raviX_init_linearizer(container);
+		rc = raviX_ast_linearize(linearizer);
+	}
+	if (rc != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+	} else {
+		size_t ast_bytes = 0, ir_bytes = 0;
+		long rss0 = peak_rss();
+		double t0 = now();
+		for (int i = 0; i < iterations; i++)
+			raviX_write_ast(container, count_bytes, &ast_bytes);
+		double t1 = now();
+		for (int i = 0; i < iterations; i++)
+			raviX_write_linearizer(linearizer, count_bytes, &ir_bytes);
+		double t2 = now();
+		long rss1 = peak_rss();
+		printf("%zu bytes, %d iterations\n", len, iterations);
+		printf("ast: %8.3f s  %8.2f MB/sec of output\n", t1 - t0, (double)ast_bytes / (t1 - t0) / 1e6);
+		printf("ir:  %8.3f s  %8.2f MB/sec of output\n", t2 - t1, (double)ir_bytes / (t2 - t1) / 1e6);
+		printf("peak rss grew by %ld KB\n", rss1 - rss0);
+	}
+	if (linearizer)
+		raviX_destroy_linearizer(linearizer);
+	raviX_destroy_compiler(container);
+}
+
+int main(int argc, const char *argv[])
+{
+	const char *mode = "lex";
+	const char *filename = NULL;
+	int iterations = 20;
+	size_t size = 1024 * 1024;
+	int style = SOURCE_CODE;
+	unsigned threads = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-f") == 0 && i < argc - 1)
+			filename = argv[++i];
+		else if (strcmp(argv[i], "-n") == 0 && i < argc - 1)
+			iterations = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i < argc - 1)
+			size = (size_t)atol(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i < argc - 1)
+			threads = (unsigned)atoi(argv[++i]);
+		else if (strcmp(argv[i], "-c") == 0)
+			style = SOURCE_COMMENTS;
+		else if (strcmp(argv[i], "-i") == 0)
+			style = SOURCE_IDENTIFIERS;
+		else if (strcmp(argv[i], "-d") == 0)
+			style = SOURCE_NUMERALS;
+		else
+			mode = argv[i];
+	}
+	char *code = filename ? (char *)read_file(filename) : generate_source(size, style);
+	if (!code) {
+		fprintf(stderr, "No code to process\n");
+		exit(1);
+	}
+	size_t len = strlen(code);
+	if (strcmp(mode, "lex") == 0)
+		bench_lex(code, len, iterations);
+	else if (strcmp(mode, "parse") == 0)
+		bench_parse(code, len, iterations);
+	else if (strcmp(mode, "scan") == 0)
+		bench_scan(code, len, iterations);
+	else if (strcmp(mode, "phases") == 0)
+		bench_phases(code, len, iterations);
+	else if (strcmp(mode, "relex") == 0)
+		bench_relex(code, len, iterations);
+	else if (strcmp(mode, "parallel") == 0)
+		bench_parallel(code, len, iterations, threads);
+	else if (strcmp(mode, "intern") == 0)
+		bench_intern(code, len, iterations, threads);
+	else if (strcmp(mode, "hash") == 0)
+		bench_hash(code, len, iterations);
+	else if (strcmp(mode, "sets") == 0)
+		bench_sets(code, len, iterations);
+	else if (strcmp(mode, "chunks") == 0)
+		bench_chunks(code, len, iterations, 0);
+	else if (strcmp(mode, "release") == 0)
+		bench_chunks(code, len, iterations, 1);
+	else if (strcmp(mode, "pool") == 0)
+		bench_pool(code, len, iterations);
+	else if (strcmp(mode, "dump") == 0)
+		bench_dump(code, len, iterations);
+	else {
+		fprintf(stderr, "Usage: tbench [lex|parse|scan|phases|relex|parallel|intern|hash|sets|chunks|release|pool|dump] [-f file] [-s size] [-n iterations] [-t threads] [-c|-i|-d]\n"
+				"  -c generates source that is mostly comments and indentation\n"
+				"  -i generates source that is mostly identifiers\n"
+				"  -d generates source that is mostly numerals\n"
+				"  -t number of threads used by the parallel lexer, 0 for all hardware threads;\n"
+				"     for intern, the number of threads interning at once, 0 for 16\n");
+		free(code);
+		return 1;
+	}
+	free(code);
+	return 0;
+}
@@ -14,6 +14,20 @@ void parse_arguments(struct arguments *args, int argc, const char *argv[])
 			args->typecheck = 0;
 		} else if (strcmp(argv[i], "--nolinearize") == 0) {
 			args->linearize = 0;
+		} else if (strcmp(argv[i], "--zerocopy") == 0) {
+			args->zero_copy = 1;
+		} else if (strcmp(argv[i], "--stats") == 0) {
+			args->stats = 1;
+		} else if (strcmp(argv[i], "--tokens") == 0) {
+			args->token_stream = 1;
+		} else if (strcmp(argv[i], "--blocksize") == 0) {
+			if (i < argc - 1) {
+				i++;
+				args->block_size = (unsigned)atoi(argv[i]);
+			} else {
+				fprintf(stderr, "Missing size after --blocksize\n");
+				exit(1);
+			}
 		} else if (strcmp(argv[i], "-f") == 0) {
 			if (args->filename) {
 				fprintf(stderr, "-f already accepted\n");
@@ -69,3 +83,27 @@ const char *read_file(const char *filename)
 
 
 
+
+void init_block_reader(struct block_reader *reader, const char *code, size_t len, size_t block_size)
+{
+	reader->code = code;
+	reader->remaining = len;
+	reader->block_size = block_size;
+	reader->block = (char *)malloc(block_size);
+}
+
+const char *read_block(void *data, size_t *size)
+{
+	struct block_reader *reader = (struct block_reader *)data;
+	size_t n = reader->remaining < reader->block_size ? reader->remaining : reader->block_size;
+	*size = n;
+	if (n == 0)
+		return NULL;
+	/* the previous block is overwritten, so the lexer must not hold on to it */
+	memcpy(reader->block, reader->code, n);
+	reader->code += n;
+	reader->remaining -= n;
+	return reader->block;
+}
+
+void destroy_block_reader(struct block_reader *reader) { free(reader->block); }
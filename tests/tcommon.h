@@ -1,12 +1,27 @@
 #ifndef ravicomp_TCOMMON_H
 #define ravicomp_TCOMMON_H
 
+#include <stddef.h>
+
 struct arguments {
 	const char *filename;
 	const char *code;
-	unsigned typecheck : 1, linearize : 1;
+	unsigned typecheck : 1, linearize : 1, zero_copy : 1, stats : 1;
+	unsigned token_stream : 1; /* lex with raviX_lex_all() and parse the token stream */
+	unsigned block_size; /* if non-zero the code is fed to the lexer in blocks of this size */
 };
 extern void parse_arguments(struct arguments *args, int argc, const char *argv[]);
 extern const char *read_file(const char *filename);
 
+/* Reader that hands out the code in blocks, each copied to a scratch buffer that is reused */
+struct block_reader {
+	const char *code;
+	size_t remaining;
+	size_t block_size;
+	char *block;
+};
+extern void init_block_reader(struct block_reader *reader, const char *code, size_t len, size_t block_size);
+extern const char *read_block(void *data, size_t *size);
+extern void destroy_block_reader(struct block_reader *reader);
+
 #endif
\ No newline at end of file
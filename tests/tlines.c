@@ -0,0 +1,175 @@
+/* checks the offsets of tokens, statements and expressions, and their mapping to lines and columns
+ * with each kind of line ending */
+
+#include <ravi_compiler.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/* Line and column of offset, counting line breaks as the lexer does: "\n", "\r", "\r\n" and "\n\r" */
+static void expected_line_and_column(const char *code, uint32_t offset, int *line, int *column)
+{
+	uint32_t line_start = 0;
+	*line = 1;
+	for (uint32_t i = 0; i < offset;) {
+		if (code[i] == '\n' || code[i] == '\r') {
+			if ((code[i + 1] == '\n' || code[i + 1] == '\r') && code[i + 1] != code[i])
+				i++;
+			line_start = ++i;
+			++*line;
+		} else {
+			i++;
+		}
+	}
+	*column = (int)(offset - line_start) + 1;
+}
+
+static const char *const sources[] = {
+    "local a = 1\nlocal bb = 'x'\n  return a, bb\n",
+    "local a = 1\r\nlocal bb = 'x'\r\n  return a, bb\r\n",
+    "local a = 1\n\rlocal bb = 'x'\n\r  return a, bb\n\r",
+    "local a = 1\r\rlocal bb = [[\nlong\r\nstring]]\n\nreturn a, bb", /* no newline at the end */
+    "return", /* the only token is on the last line */
+};
+
+enum { NSOURCES = sizeof sources / sizeof sources[0] };
+
+/* line is the line the lexer gave for the token, -1 if there is none */
+static int check_position(struct compiler_state *container, const char *code, uint32_t offset, int line,
+			  const char *what)
+{
+	int expected_line, expected_column, actual_line, actual_column;
+	expected_line_and_column(code, offset, &expected_line, &expected_column);
+	raviX_get_line_and_column(container, offset, &actual_line, &actual_column);
+	if (actual_line != expected_line || actual_column != expected_column ||
+	    (line >= 0 && line != expected_line)) {
+		fprintf(stderr, "%s at offset %u: expected %d:%d, got %d:%d, token line %d\n", what, offset,
+			expected_line, expected_column, actual_line, actual_column, line);
+		return 1;
+	}
+	return 0;
+}
+
+/* Token offsets from the pull lexer and from raviX_lex_all() must agree, and map to the right line and column */
+static int check_tokens(const char *code)
+{
+	int rc = 0;
+	struct compiler_state *container = raviX_init_compiler();
+	struct lexer_state *ls = raviX_init_lexer(container, code, strlen(code), "input");
+	const LexState *info = raviX_get_lexer_info(ls);
+	uint32_t pulled[64];
+	uint32_t count = 0;
+	do {
+		raviX_next(ls);
+		pulled[count++] = info->t.offset;
+		if (info->t.token != TOK_EOS)
+			rc += check_position(container, code, info->t.offset, -1, "pulled token");
+	} while (info->t.token != TOK_EOS && count < 64);
+	raviX_destroy_lexer(ls);
+
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	if (raviX_lex_all(container, code, strlen(code), "input", &stream) != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		rc++;
+	} else if (stream.count != count) {
+		fprintf(stderr, "lexed %u tokens, pulled %u\n", stream.count, count);
+		rc++;
+	} else {
+		for (uint32_t i = 0; i + 1 < stream.count; i++) {
+			if (stream.offset[i] != pulled[i]) {
+				fprintf(stderr, "token %u at offset %u, pulled at %u\n", i, stream.offset[i], pulled[i]);
+				rc++;
+			}
+			rc += check_position(container, code, stream.offset[i], stream.line[i], "token");
+		}
+	}
+	raviX_destroy_token_stream(&stream);
+	raviX_destroy_compiler(container);
+	return rc;
+}
+
+struct positions {
+	struct compiler_state *container;
+	char text[256]; /* line:column of each node visited, separated by spaces */
+};
+
+static void add_position(struct positions *positions, uint32_t offset)
+{
+	int line, column;
+	raviX_get_line_and_column(positions->container, offset, &line, &column);
+	size_t len = strlen(positions->text);
+	snprintf(positions->text + len, sizeof positions->text - len, "%s%d:%d", len ? " " : "", line, column);
+}
+
+static void add_expression(void *data, const struct expression *expression)
+{
+	add_position((struct positions *)data, raviX_expression_offset(expression));
+}
+
+static void add_statement(void *data, const struct statement *statement)
+{
+	struct positions *positions = (struct positions *)data;
+	add_position(positions, raviX_statement_offset(statement));
+	switch (raviX_statement_type(statement)) {
+	case STMT_LOCAL:
+		raviX_local_statement_foreach_expression(raviX_local_statement(statement), data, add_expression);
+		break;
+	case STMT_RETURN:
+		raviX_return_statement_foreach_expression(raviX_return_statement(statement), data, add_expression);
+		break;
+	case STMT_EXPR:
+		raviX_expression_statement_foreach_rhs_expression(raviX_expression_statement(statement), data,
+								  add_expression);
+		break;
+	default:
+		break;
+	}
+}
+
+struct node_case {
+	const char *code;
+	const char *positions; /* of each statement, followed by those of its expressions */
+};
+
+/* A node's offset is that of the last token consumed when it was created: for a literal or a name that is
+ * the token before it, and for a binary expression its right operand */
+static const struct node_case node_cases[] = {
+    {"local a = 1\nlocal bb = 'x'\n  return a, bb\n", "1:1 1:9 2:1 2:10 3:3 3:3 3:11"},
+    {"local a = 1\r\nx = a + 2\r\nreturn x", "1:1 1:9 1:11 2:9 3:1 3:1"},
+    {"print(1)\n\rreturn f(2), 3", "1:1 1:1 2:1 2:1 2:12"},
+};
+
+enum { NNODE_CASES = sizeof node_cases / sizeof node_cases[0] };
+
+static int check_nodes(const struct node_case *node_case)
+{
+	int rc = 0;
+	struct positions positions;
+	positions.container = raviX_init_compiler();
+	positions.text[0] = 0;
+	if (raviX_parse(positions.container, node_case->code, strlen(node_case->code), "input") != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(positions.container));
+		rc++;
+	} else {
+		raviX_function_foreach_statement(raviX_ast_get_main_function(positions.container), &positions,
+						 add_statement);
+		if (strcmp(positions.text, node_case->positions) != 0) {
+			fprintf(stderr, "%s: expected nodes at %s, got %s\n", node_case->code, node_case->positions,
+				positions.text);
+			rc++;
+		}
+	}
+	raviX_destroy_compiler(positions.container);
+	return rc;
+}
+
+int main(int argc, const char *argv[])
+{
+	int rc = 0;
+	for (int i = 0; i < NSOURCES; i++)
+		rc += check_tokens(sources[i]);
+	for (int i = 0; i < NNODE_CASES; i++)
+		rc += check_nodes(&node_cases[i]);
+	return rc;
+}
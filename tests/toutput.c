@@ -0,0 +1,135 @@
+/* checks that the AST and IR dumps written through a writer in pieces match the FILE output, and
+ * that the number formatting of membuff_t matches printf */
+
+#include <ravi_compiler.h>
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { STATEMENTS = 2000 };
+
+struct collected {
+	char *data;
+	size_t len;
+	int pieces;
+};
+
+static void collect(void *data, const char *bytes, size_t size)
+{
+	struct collected *out = (struct collected *)data;
+	out->data = (char *)realloc(out->data, out->len + size + 1);
+	memcpy(out->data + out->len, bytes, size);
+	out->len += size;
+	out->data[out->len] = 0;
+	out->pieces++;
+}
+
+static char *read_back(FILE *fp, size_t *len)
+{
+	long size = ftell(fp);
+	char *result = (char *)calloc(1, (size_t)size + 1);
+	rewind(fp);
+	*len = fread(result, 1, (size_t)size, fp);
+	fclose(fp);
+	return result;
+}
+
+static int compare(const char *what, struct collected *written, FILE *fp)
+{
+	size_t len;
+	char *expected = read_back(fp, &len);
+	int rc = 0;
+	if (written->len != len || memcmp(written->data, expected, len) != 0) {
+		fprintf(stderr, "%s written through a writer differs from the FILE output\n", what);
+		rc = 1;
+	} else if (written->pieces < 2) {
+		fprintf(stderr, "%s was written in %d pieces\n", what, written->pieces);
+		rc = 1;
+	}
+	free(expected);
+	free(written->data);
+	return rc;
+}
+
+/* A chunk whose dumps are many times the size of a piece */
+static int check_writer(void)
+{
+	membuff_t code;
+	raviX_buffer_init(&code, 1024);
+	for (int i = 0; i < STATEMENTS; i++)
+		raviX_buffer_add_fstring(&code, "x%d = %d * %d.25 + y%d; s%d = 'str%d'\n", i, i, i, i, i, i);
+	struct compiler_state *container = raviX_init_compiler();
+	int rc = raviX_parse(container, raviX_buffer_data(&code), raviX_buffer_len(&code), "input");
+	if (rc == 0)
+		rc = raviX_ast_typecheck(container);
+	if (rc != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+	} else {
+		struct collected ast = {NULL, 0, 0};
+		FILE *fp = tmpfile();
+		raviX_write_ast(container, collect, &ast);
+		raviX_output_ast(container, fp);
+		rc += compare("AST", &ast, fp);
+
+		struct linearizer_state *linearizer = raviX_init_linearizer(container);
+		if (raviX_ast_linearize(linearizer) != 0) {
+			fprintf(stderr, "%s\n", raviX_get_last_error(container));
+			rc++;
+		} else {
+			struct collected ir = {NULL, 0, 0};
+			fp = tmpfile();
+			raviX_write_linearizer(linearizer, collect, &ir);
+			raviX_output_linearizer(linearizer, fp);
+			rc += compare("IR", &ir, fp);
+		}
+		raviX_destroy_linearizer(linearizer);
+	}
+	raviX_destroy_compiler(container);
+	raviX_buffer_free(&code);
+	return rc;
+}
+
+static int check_numbers(void)
+{
+	static const int64_t integers[] = {0, 1, -1, 9, 10, 99, 100, -100, 123456789, INT64_MAX, INT64_MIN};
+	static const double doubles[] = {0.0,	 -0.0,	     1.0,		-1.0,	 1.5,	   0.1,	  -2.75,
+					 1e-20,	 123456.0,   9007199254740992.0, 9007199254740994.0,	   1e300, -1e300,
+					 HUGE_VAL,   -HUGE_VAL};
+	static const int digits[] = {0, 1, 12, 16};
+	char expected[512];
+	int rc = 0;
+	membuff_t mb;
+	raviX_buffer_init(&mb, 16);
+	for (size_t i = 0; i < sizeof integers / sizeof integers[0]; i++) {
+		raviX_buffer_reset(&mb);
+		raviX_buffer_add_longlong(&mb, integers[i]);
+		snprintf(expected, sizeof expected, "%" PRId64, integers[i]);
+		if (strcmp(raviX_buffer_data(&mb), expected) != 0) {
+			fprintf(stderr, "%s printed as %s\n", expected, raviX_buffer_data(&mb));
+			rc++;
+		}
+	}
+	for (size_t i = 0; i < sizeof doubles / sizeof doubles[0]; i++) {
+		for (size_t j = 0; j < sizeof digits / sizeof digits[0]; j++) {
+			raviX_buffer_reset(&mb);
+			raviX_buffer_add_double(&mb, doubles[i], digits[j]);
+			snprintf(expected, sizeof expected, "%.*f", digits[j], doubles[i]);
+			if (strcmp(raviX_buffer_data(&mb), expected) != 0) {
+				fprintf(stderr, "%s printed as %s\n", expected, raviX_buffer_data(&mb));
+				rc++;
+			}
+		}
+	}
+	raviX_buffer_free(&mb);
+	return rc;
+}
+
+int main(int argc, const char *argv[])
+{
+	int rc = check_writer();
+	rc += check_numbers();
+	return rc;
+}
@@ -0,0 +1,196 @@
+/* checks that the parallel lexer gives the same result as the sequential one, when slices start
+ * inside long strings, comments, quoted strings and at other awkward places */
+
+#include <ravi_compiler.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const fragments[] = {
+    "local x = 1\n",
+    "--[[ long comment\n with -- and [[ and ' inside\n]]\n",
+    "--[==[ not closed by ]] or ]=]\n ]==]",
+    "--[=[\n]]\n]=]\n",
+    "--[ not a long comment\n",
+    "-- short comment with [[ and \" in it\n",
+    "s = [[ long string\n -- not a comment\n ' \" ]]\n",
+    "s = [==[\n]]\n]=]\n]==]\n",
+    "t = { [ [[key]] ] = 1 }\n",
+    "a[b[c]] = d\n",
+    "q = 'quoted -- [[ not long \\\n continued'\n",
+    /* a slice starting after the line break sees quoted strings that swallow the real tokens */
+    "s = [[\nx = ']] .. 'y' .. [[z']]\n",
+    "--[[\nx = ']] y = 1 -- '\n",
+    "q = 'a\\\nb' .. c -- '\n",
+    "q = \"skip\\z\n     spaces\"\n",
+    "q = \"escapes \\65\\x41 \\\"\\\\\"\n",
+    "n = 0x1p4 + 3.5e+2 .. 1e10 // 7\n",
+    "local i: integer, f: number[] = @integer(1), {}\n",
+    "\r\n",
+    "\n\r",
+    "\n\n\n",
+    "   \t ",
+    "::label:: goto label\n",
+    "return a ~= b and c <= d or e >> 2\n",
+};
+
+static unsigned random_state = 42;
+
+static unsigned random_number(void)
+{
+	random_state = random_state * 1103515245u + 12345u;
+	return (random_state >> 16) & 0x7fff;
+}
+
+static char *generate_source(size_t size, int unterminated)
+{
+	char *buf = (char *)malloc(size + 256);
+	size_t pos = 0;
+	while (pos < size) {
+		const char *s = fragments[random_number() % (sizeof fragments / sizeof fragments[0])];
+		size_t len = strlen(s);
+		memcpy(buf + pos, s, len);
+		pos += len;
+	}
+	if (unterminated) {
+		const char *s = unterminated == 1 ? "x = [[ never closed\n" : "x = 'not closed\n";
+		strcpy(buf + pos, s);
+		pos += strlen(s);
+	}
+	buf[pos] = 0;
+	return buf;
+}
+
+static int compare_tokens(const TokenStream *expected, const TokenStream *actual, struct compiler_state *container)
+{
+	if (expected->count != actual->count) {
+		fprintf(stderr, "token count %u, expected %u\n", actual->count, expected->count);
+		return 1;
+	}
+	for (uint32_t i = 0; i < expected->count; i++) {
+		if (expected->token[i] != actual->token[i] || expected->offset[i] != actual->offset[i] ||
+		    expected->length[i] != actual->length[i] || expected->line[i] != actual->line[i]) {
+			fprintf(stderr, "token %u differs\n", i);
+			return 1;
+		}
+		int token = expected->token[i];
+		if (token == TOK_NAME || token == TOK_STRING || token == '@') {
+			const struct string_object *s = actual->seminfo[i].ts;
+			if (s->len != expected->seminfo[i].ts->len || memcmp(s->str, expected->seminfo[i].ts->str, s->len) != 0 ||
+			    s != raviX_create_string(container, s->str, s->len)) {
+				fprintf(stderr, "string of token %u differs\n", i);
+				return 1;
+			}
+		} else if (token == TOK_INT && expected->seminfo[i].i != actual->seminfo[i].i) {
+			fprintf(stderr, "integer of token %u differs\n", i);
+			return 1;
+		} else if (token == TOK_FLT && memcmp(&expected->seminfo[i].r, &actual->seminfo[i].r, sizeof(double)) != 0) {
+			fprintf(stderr, "number of token %u differs\n", i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* the parallel lexer must not keep strings the sequential one never saw, such as the contents of a
+ * comment that a slice took for code */
+static int compare_strings(struct compiler_state *expected, struct compiler_state *actual)
+{
+	struct compiler_stats expected_stats, actual_stats;
+	raviX_get_compiler_stats(expected, &expected_stats);
+	raviX_get_compiler_stats(actual, &actual_stats);
+	if (expected_stats.strings != actual_stats.strings ||
+	    expected_stats.string_bytes != actual_stats.string_bytes) {
+		fprintf(stderr, "%zu strings of %zu bytes, expected %zu of %zu bytes\n", actual_stats.strings,
+			actual_stats.string_bytes, expected_stats.strings, expected_stats.string_bytes);
+		return 1;
+	}
+	return 0;
+}
+
+/* the token stream must also match what the pull api returns */
+static int compare_with_pull(const char *code, size_t len, const TokenStream *stream)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	struct lexer_state *ls = raviX_init_lexer(container, code, len, "input");
+	const LexState *info = raviX_get_lexer_info(ls);
+	int rc = 0;
+	uint32_t i = 0;
+	do {
+		raviX_next(ls);
+		if (i >= stream->count || info->t.token != stream->token[i] || info->t.offset != stream->offset[i]) {
+			fprintf(stderr, "token %u differs from the pull api\n", i);
+			rc = 1;
+			break;
+		}
+		i++;
+	} while (info->t.token != TOK_EOS);
+	raviX_destroy_lexer(ls);
+	raviX_destroy_compiler(container);
+	return rc;
+}
+
+static int check(const char *code, unsigned threads, size_t slice_size, struct string_interner *interner)
+{
+	size_t len = strlen(code);
+	TokenStream expected, actual;
+	memset(&expected, 0, sizeof expected);
+	memset(&actual, 0, sizeof actual);
+	struct compiler_state *container1 = raviX_init_compiler();
+	struct compiler_state *container2 = raviX_init_compiler();
+	raviX_set_string_interner(container2, interner);
+	int rc1 = raviX_lex_all(container1, code, len, "input", &expected);
+	int rc2 = raviX_lex_all_parallel(container2, code, len, "input", &actual, threads, slice_size);
+	int rc = 0;
+	if ((rc1 != 0) != (rc2 != 0)) {
+		fprintf(stderr, "result %d, expected %d\n", rc2, rc1);
+		rc = 1;
+	} else if (rc1 != 0) {
+		if (strcmp(raviX_get_last_error(container1), raviX_get_last_error(container2)) != 0) {
+			fprintf(stderr, "error '%s', expected '%s'\n", raviX_get_last_error(container2),
+				raviX_get_last_error(container1));
+			rc = 1;
+		}
+	} else {
+		rc = compare_tokens(&expected, &actual, container2);
+		if (rc == 0 && !interner)
+			rc = compare_strings(container1, container2);
+		if (rc == 0 && threads == 2)
+			rc = compare_with_pull(code, len, &actual);
+	}
+	if (rc != 0)
+		fprintf(stderr, "with %u threads, slices of %zu bytes\n", threads, slice_size);
+	raviX_destroy_token_stream(&expected);
+	raviX_destroy_token_stream(&actual);
+	raviX_destroy_compiler(container1);
+	raviX_destroy_compiler(container2);
+	return rc;
+}
+
+int main(int argc, const char *argv[])
+{
+	int rc = 0;
+	static const unsigned threads[] = {2, 3, 8};
+	for (int i = 0; i < 100 && rc == 0; i++) {
+		/* some inputs end with an unterminated string, so that lexing fails */
+		char *code = generate_source(2000, i % 5 == 4 ? 1 + i % 2 : 0);
+		for (size_t slice_size = 1; slice_size <= 64 && rc == 0; slice_size++)
+			rc = check(code, threads[slice_size % 3], slice_size, NULL);
+		free(code);
+	}
+	/* the workers can intern strings in a shared interner directly */
+	struct string_interner *interner = raviX_create_string_interner();
+	char *code = generate_source(2000, 0);
+	for (size_t slice_size = 1; slice_size <= 64 && rc == 0; slice_size++)
+		rc = check(code, threads[slice_size % 3], slice_size, interner);
+	free(code);
+	code = generate_source(2000000, 0);
+	if (rc == 0)
+		rc = check(code, 0, 0, NULL);
+	if (rc == 0)
+		rc = check(code, 0, 0, interner);
+	free(code);
+	raviX_destroy_string_interner(interner);
+	return rc;
+}
@@ -7,6 +7,25 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* statistics go to stderr so that the output compared by the tests is unchanged */
+static void print_stats(struct compiler_state *container)
+{
+	static const char *const phases[COMPILER_PHASE_COUNT] = {"lex", "parse", "typecheck", "linearize"};
+	struct compiler_stats stats;
+	raviX_get_compiler_stats(container, &stats);
+	for (int i = 0; i < COMPILER_PHASE_COUNT; i++)
+		fprintf(stderr, "%-10s %u calls %10.3f ms %10llu bytes\n", phases[i], stats.phases[i].calls,
+			stats.phases[i].nanoseconds / 1e6, (unsigned long long)stats.phases[i].bytes);
+	for (unsigned i = 0; i < stats.allocator_count; i++)
+		fprintf(stderr, "%-22s %8zu bytes held %8zu used %6zu objects\n", stats.allocators[i].name,
+			stats.allocators[i].total_bytes, stats.allocators[i].used_bytes, stats.allocators[i].objects);
+	fprintf(stderr,
+		"ast nodes %zu, symbols %zu, ptrlist nodes %zu, pseudos %zu, instructions %zu, blocks %zu, "
+		"strings %zu of %zu bytes (peak %zu)\n",
+		stats.ast_nodes, stats.symbols, stats.ptrlist_nodes, stats.pseudos, stats.instructions,
+		stats.basic_blocks, stats.strings, stats.string_bytes, stats.peak_string_bytes);
+}
+
 int main(int argc, const char *argv[])
 {
 	struct arguments args;
@@ -36,8 +55,22 @@ int main(int argc, const char *argv[])
 
 	printf("%s\n", code);
 	int rc = 0;
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
 	struct compiler_state *container = raviX_init_compiler();
-	rc = raviX_parse(container, code, strlen(code), "input");
+	raviX_set_zero_copy_strings(container, args.zero_copy);
+	if (args.token_stream) {
+		rc = raviX_lex_all(container, code, strlen(code), "input", &stream);
+		if (rc == 0)
+			rc = raviX_parse_token_stream(container, &stream, "input");
+	} else if (args.block_size) {
+		struct block_reader reader;
+		init_block_reader(&reader, code, strlen(code), args.block_size);
+		rc = raviX_parse_with_reader(container, read_block, &reader, "input");
+		destroy_block_reader(&reader);
+	} else {
+		rc = raviX_parse(container, code, strlen(code), "input");
+	}
 	if (rc != 0) {
 		fprintf(stderr, "%s\n", raviX_get_last_error(container));
 		goto L_exit;
@@ -63,6 +96,9 @@ L_linend:
 	raviX_destroy_linearizer(linearizer);
 
 L_exit:
+	if (args.stats)
+		print_stats(container);
+	raviX_destroy_token_stream(&stream);
 	raviX_destroy_compiler(container);
 
 	return rc;
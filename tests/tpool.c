@@ -0,0 +1,132 @@
+/* checks that compiler states that are reset, or recycled through a pool, compile chunks exactly
+ * as fresh compiler states do */
+
+#include <ravi_compiler.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const chunks[] = {
+    "local a: integer, b: number = 1, 2.5\n"
+    "local t = { a = a, b, 'str', [[long]] }\n"
+    "return t.a + b, #t, a .. 'x'\n",
+    "local function fact(n: integer)\n"
+    "  if n <= 1 then return 1 end\n"
+    "  return n * fact(n - 1)\n"
+    "end\n"
+    "return fact(10)\n",
+    "local x = (\n", /* syntax error */
+    "local s: string = 'hello'\n"
+    "for i = 1, 10 do s = s .. i end\n"
+    "return s\n",
+    "local t: table = {}\n"
+    "while t.x do t.x = t.x - 1 goto done end\n"
+    "::done:: return t\n",
+};
+
+enum { NCHUNKS = sizeof chunks / sizeof chunks[0] };
+
+/* Compiles the chunk and returns the printed syntax tree and linearized code, or the error. With
+ * release_ast the syntax tree is freed before the linearized code is printed. */
+static char *compile(struct compiler_state *container, const char *code, int release_ast)
+{
+	FILE *fp = tmpfile();
+	if (!fp)
+		return NULL;
+	int rc = raviX_parse(container, code, strlen(code), "input");
+	if (rc == 0)
+		rc = raviX_ast_typecheck(container);
+	if (rc == 0) {
+		raviX_output_ast(container, fp);
+		struct linearizer_state *linearizer = raviX_init_linearizer(container);
+		rc = raviX_ast_linearize(linearizer);
+		if (rc == 0 && release_ast)
+			rc = raviX_linearizer_release_ast(linearizer);
+		if (rc == 0)
+			raviX_output_linearizer(linearizer, fp);
+		raviX_destroy_linearizer(linearizer);
+	}
+	if (rc != 0)
+		fprintf(fp, "error: %s\n", raviX_get_last_error(container));
+	long size = ftell(fp);
+	char *result = (char *)calloc(1, (size_t)size + 1);
+	rewind(fp);
+	if (fread(result, 1, (size_t)size, fp) != (size_t)size) {
+		free(result);
+		result = NULL;
+	}
+	fclose(fp);
+	return result;
+}
+
+/* Statistics of a reset state describe only the chunk compiled since the reset */
+static int check_stats(const struct compiler_stats *expected, const struct compiler_stats *actual, int chunk)
+{
+	int rc = 0;
+	for (int i = 0; i < COMPILER_PHASE_COUNT; i++) {
+		if (actual->phases[i].calls != expected->phases[i].calls)
+			rc = 1;
+	}
+	if (actual->ast_nodes != expected->ast_nodes || actual->symbols != expected->symbols ||
+	    actual->ptrlist_nodes != expected->ptrlist_nodes || actual->pseudos != expected->pseudos ||
+	    actual->instructions != expected->instructions || actual->basic_blocks != expected->basic_blocks ||
+	    actual->strings != expected->strings || actual->string_bytes != expected->string_bytes ||
+	    actual->peak_string_bytes != expected->peak_string_bytes)
+		rc = 1;
+	if (rc)
+		fprintf(stderr, "statistics of chunk %d differ after reset\n", chunk);
+	return rc;
+}
+
+int main(void)
+{
+	char *expected[NCHUNKS];
+	struct compiler_stats expected_stats[NCHUNKS];
+	for (int i = 0; i < NCHUNKS; i++) {
+		struct compiler_state *container = raviX_init_compiler();
+		expected[i] = compile(container, chunks[i], 0);
+		raviX_get_compiler_stats(container, &expected_stats[i]);
+		raviX_destroy_compiler(container);
+	}
+	int rc = 0;
+	/* one state reset between chunks, including after a failed compile */
+	struct compiler_state *container = raviX_init_compiler();
+	for (int round = 0; round < 3; round++) {
+		for (int i = 0; i < NCHUNKS; i++) {
+			char *actual = compile(container, chunks[i], 0);
+			if (!actual || strcmp(actual, expected[i]) != 0) {
+				fprintf(stderr, "chunk %d differs after reset in round %d\n", i, round);
+				rc = 1;
+			}
+			free(actual);
+			struct compiler_stats stats;
+			raviX_get_compiler_stats(container, &stats);
+			rc |= check_stats(&expected_stats[i], &stats, i);
+			raviX_reset_compiler(container);
+		}
+	}
+	raviX_destroy_compiler(container);
+	/* states recycled through a pool that keeps fewer states than are in use, the syntax trees are
+	 * released once linearized */
+	struct compiler_pool *pool = raviX_create_compiler_pool(2);
+	for (int round = 0; round < 3; round++) {
+		struct compiler_state *states[NCHUNKS];
+		for (int i = 0; i < NCHUNKS; i++) {
+			states[i] = raviX_compiler_pool_acquire(pool);
+			char *actual = compile(states[i], chunks[(i + round) % NCHUNKS], 1);
+			if (!actual || strcmp(actual, expected[(i + round) % NCHUNKS]) != 0) {
+				fprintf(stderr, "chunk %d differs with a pooled state in round %d\n", (i + round) % NCHUNKS,
+					round);
+				rc = 1;
+			}
+			free(actual);
+		}
+		for (int i = 0; i < NCHUNKS; i++)
+			raviX_compiler_pool_release(pool, states[i]);
+	}
+	raviX_destroy_compiler_pool(pool);
+	for (int i = 0; i < NCHUNKS; i++)
+		free(expected[i]);
+	return rc;
+}
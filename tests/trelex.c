@@ -0,0 +1,185 @@
+/* checks that raviX_relex() after an edit gives the same tokens, values, lines and line table as lexing
+ * the edited source from scratch, for edits in, at the start of and across strings and comments */
+
+#include <ravi_compiler.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char source[] = "local s = \"a\\tb\\\"c\" -- short string with escapes\n"
+			     "local t = [==[\n"
+			     "first line\n"
+			     "second ]] line]==]\n"
+			     "--[[ long\n"
+			     "comment ]] x = 1\r\n"
+			     "y = 'it\\'s' .. s\n"
+			     "return s, t, 0x10, 2.5";
+
+/* Replaces 'removed' bytes at 'skip' bytes into the first occurrence of 'marker' by 'inserted' */
+struct edit {
+	const char *marker;
+	size_t skip;
+	size_t removed;
+	const char *inserted;
+};
+
+static const struct edit edits[] = {
+    {"first", 5, 0, "zz"},			/* inside a long string */
+    {"first", 0, 6, "\n\n"},			/* inside a long string, adding lines */
+    {"[==[", 0, 4, "[["},			/* at the start of a long string, which now ends earlier */
+    {"[[", 0, 2, "[==["},			/* and back */
+    {"line]==]", 0, 10, "end]==] --"},		/* across the end of a long string, the comment becomes short */
+    {"comment", 0, 7, "changed\n\n"},		/* inside a long comment */
+    {"--[[", 0, 4, ""},				/* at the start of a long comment, which becomes code */
+    {"long\n", 0, 0, "--[["},			/* and back */
+    {"]] x", 0, 2, ""},				/* removes the end of the long comment, which now fails */
+    {"\\tb", 0, 2, "\\x41"},			/* inside an escape of a short string */
+    {"\"a", 0, 1, "'"},				/* at the start of a short string, which now fails */
+    {"it\\'", 2, 2, "\\n\\65"},			/* escapes in the middle of a short string */
+    {"'it", 0, 0, "\"q\" .. "},			/* before a short string */
+    {"x = 1\r\n", 5, 2, "\n\r"},		/* a line break of another kind */
+    {"local s", 0, 0, "\n\n-- start\n"},	/* at the start of the input */
+    {"2.5", 3, 0, " + 1e3"},			/* at the end of the input */
+};
+
+enum { NEDITS = sizeof edits / sizeof edits[0] };
+
+static int same_value(const TokenStream *a, const TokenStream *b, uint32_t i)
+{
+	switch (a->token[i]) {
+	case TOK_NAME:
+	case TOK_STRING:
+		return a->seminfo[i].ts->len == b->seminfo[i].ts->len &&
+		       memcmp(a->seminfo[i].ts->str, b->seminfo[i].ts->str, a->seminfo[i].ts->len) == 0;
+	case TOK_INT:
+		return a->seminfo[i].i == b->seminfo[i].i;
+	case TOK_FLT:
+		return memcmp(&a->seminfo[i].r, &b->seminfo[i].r, sizeof a->seminfo[i].r) == 0;
+	default:
+		return 1;
+	}
+}
+
+/* The relexed stream and its compiler state's line table must be those of a fresh lex of code */
+static int compare(const char *what, struct compiler_state *relexed_container, const TokenStream *relexed,
+		   const char *code)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	TokenStream fresh;
+	memset(&fresh, 0, sizeof fresh);
+	int rc = 0;
+	if (raviX_lex_all(container, code, strlen(code), "input", &fresh) != 0) {
+		fprintf(stderr, "%s: %s\n", what, raviX_get_last_error(container));
+		rc = 1;
+	} else if (fresh.count != relexed->count) {
+		fprintf(stderr, "%s: %u tokens after relexing, %u when lexed afresh\n", what, relexed->count,
+			fresh.count);
+		rc = 1;
+	} else {
+		for (uint32_t i = 0; i < fresh.count && rc == 0; i++) {
+			if (fresh.token[i] != relexed->token[i] || fresh.offset[i] != relexed->offset[i] ||
+			    fresh.length[i] != relexed->length[i] || fresh.line[i] != relexed->line[i] ||
+			    !same_value(&fresh, relexed, i)) {
+				fprintf(stderr, "%s: token %u differs from a fresh lex\n", what, i);
+				rc = 1;
+			}
+		}
+		size_t len = strlen(code);
+		for (uint32_t offset = 0; offset <= len && rc == 0; offset++) {
+			int line, column, fresh_line, fresh_column;
+			raviX_get_line_and_column(relexed_container, offset, &line, &column);
+			raviX_get_line_and_column(container, offset, &fresh_line, &fresh_column);
+			if (line != fresh_line || column != fresh_column) {
+				fprintf(stderr, "%s: offset %u is at %d:%d after relexing, %d:%d when lexed afresh\n",
+					what, offset, line, column, fresh_line, fresh_column);
+				rc = 1;
+			}
+		}
+	}
+	raviX_destroy_token_stream(&fresh);
+	raviX_destroy_compiler(container);
+	return rc;
+}
+
+/* Returns a copy of code with the edit applied, and the offset of the edit */
+static char *apply(const char *code, const struct edit *edit, size_t *offset)
+{
+	const char *at = strstr(code, edit->marker);
+	if (!at) {
+		fprintf(stderr, "%s not found\n", edit->marker);
+		exit(1);
+	}
+	*offset = (size_t)(at - code) + edit->skip;
+	size_t len = strlen(code), inserted = strlen(edit->inserted);
+	char *edited = (char *)malloc(len - edit->removed + inserted + 1);
+	memcpy(edited, code, *offset);
+	memcpy(edited + *offset, edit->inserted, inserted);
+	strcpy(edited + *offset + inserted, code + *offset + edit->removed);
+	return edited;
+}
+
+static int lexes(const char *code)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	int ok = raviX_lex_all(container, code, strlen(code), "input", &stream) == 0;
+	raviX_destroy_token_stream(&stream);
+	raviX_destroy_compiler(container);
+	return ok;
+}
+
+/* Each edit on its own to the original source if 'cumulative' is false, else one after the other; edits
+ * that make the source fail to lex are undone */
+static int check_edits(int cumulative)
+{
+	int rc = 0;
+	struct compiler_state *container = raviX_init_compiler();
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	char *code = strdup(source);
+	if (raviX_lex_all(container, code, strlen(code), "input", &stream) != 0) {
+		fprintf(stderr, "%s\n", raviX_get_last_error(container));
+		rc = 1;
+	}
+	for (int i = 0; i < NEDITS && rc == 0; i++) {
+		size_t offset;
+		char *edited = apply(code, &edits[i], &offset);
+		char what[64];
+		snprintf(what, sizeof what, "edit %d%s", i, cumulative ? " in sequence" : "");
+		int relexed = raviX_relex(container, &stream, edited, strlen(edited), offset, edits[i].removed,
+					  strlen(edits[i].inserted), "input") == 0;
+		if (relexed != lexes(edited)) {
+			fprintf(stderr, "%s: relex %s but a fresh lex %s\n", what, relexed ? "worked" : "failed",
+				relexed ? "fails" : "works");
+			rc = 1;
+		} else if (!relexed) {
+			rc = compare(what, container, &stream, code); /* the stream must be unchanged */
+		} else {
+			rc = compare(what, container, &stream, edited);
+		}
+		if (relexed && cumulative) {
+			/* the old source must stay alive until the stream has been relexed */
+			free(code);
+			code = edited;
+		} else if (relexed) {
+			free(edited);
+			/* undo the edit */
+			raviX_lex_all(container, code, strlen(code), "input", &stream);
+		} else {
+			free(edited);
+		}
+	}
+	raviX_destroy_token_stream(&stream);
+	raviX_destroy_compiler(container);
+	free(code);
+	return rc;
+}
+
+int main(int argc, const char *argv[])
+{
+	int rc = check_edits(0);
+	rc += check_edits(1);
+	return rc;
+}
@@ -0,0 +1,65 @@
+/* checks that parsing through a token stream reports syntax errors exactly as the pull parser does;
+ * that the output is the same is checked by running the tests with tparse --tokens */
+
+#include <ravi_compiler.h>
+
+#include <stdio.h>
+#include <string.h>
+
+struct error_case {
+	const char *code;
+	const char *near; /* text the error must end with */
+};
+
+static const struct error_case cases[] = {
+    {"local x = 1 'q\\tz'", "near ''q\tz''"}, /* escapes are shown converted */
+    {"local x = 1 \"it\\'s\\65\"", "near '\"it'sA\"'"},
+    {"local x = 1 [==[\nlong ]] string]==]", "near '[==[long ]] string]==]'"},
+    {"local x = 1 [[plain]]", "near '[[plain]]'"},
+    {"local x = 1 0x1p4", "near '0x1p4'"},
+    {"local x = 1 2.5e3", "near '2.5e3'"},
+    {"for i j do end", "near 'j'"},
+    {"for i 'a\\nb' do end", "near ''a\nb''"},
+};
+
+enum { NCASES = sizeof cases / sizeof cases[0] };
+
+/* Returns a copy of the error from parsing the code, through a token stream if token_stream is set */
+static void parse_error(const char *code, int token_stream, char *error, size_t size)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	TokenStream stream;
+	memset(&stream, 0, sizeof stream);
+	int rc;
+	if (token_stream) {
+		rc = raviX_lex_all(container, code, strlen(code), "input", &stream);
+		if (rc == 0)
+			rc = raviX_parse_token_stream(container, &stream, "input");
+	} else {
+		rc = raviX_parse(container, code, strlen(code), "input");
+	}
+	raviX_string_copy(error, rc != 0 ? raviX_get_last_error(container) : "", size);
+	raviX_destroy_token_stream(&stream);
+	raviX_destroy_compiler(container);
+}
+
+int main(int argc, const char *argv[])
+{
+	int rc = 0;
+	char pulled[256], streamed[256];
+	for (int i = 0; i < NCASES; i++) {
+		parse_error(cases[i].code, 0, pulled, sizeof pulled);
+		parse_error(cases[i].code, 1, streamed, sizeof streamed);
+		size_t len = strlen(pulled), near_len = strlen(cases[i].near);
+		if (len < near_len || strcmp(pulled + len - near_len, cases[i].near) != 0) {
+			fprintf(stderr, "%s: expected an error %s, got %s\n", cases[i].code, cases[i].near, pulled);
+			rc++;
+		}
+		if (strcmp(pulled, streamed) != 0) {
+			fprintf(stderr, "%s: pull parser reported %s, token stream %s\n", cases[i].code, pulled,
+				streamed);
+			rc++;
+		}
+	}
+	return rc;
+}
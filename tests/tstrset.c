@@ -1,7 +1,29 @@
 #include <ravi_compiler.h>
 
+#include <stdio.h>
 #include <string.h>
 
+enum { MANY = 20000 };
+
+/* Interns enough distinct strings for the table to grow many times, each must still be found */
+static int check_many(struct compiler_state *container)
+{
+	static const struct string_object *strings[MANY];
+	char name[32];
+	int rc = 0;
+	for (int i = 0; i < MANY; i++) {
+		int len = snprintf(name, sizeof name, "name%d", i);
+		strings[i] = raviX_create_string(container, name, (uint32_t)len);
+	}
+	for (int i = 0; i < MANY; i++) {
+		int len = snprintf(name, sizeof name, "name%d", i);
+		const struct string_object *s = raviX_create_string(container, name, (uint32_t)len);
+		if (s != strings[i] || strcmp(s->str, name) != 0)
+			rc++;
+	}
+	return rc;
+}
+
 int main(int argc, const char *argv[])
 {
 	struct compiler_state *container = raviX_init_compiler();
@@ -20,7 +42,43 @@ int main(int argc, const char *argv[])
 		rc++;
 	if (s2->hash != s3->hash)
 		rc++;
+	if (s2->reserved != TOK_LOCAL - FIRST_RESERVED)
+		rc++;
+	/* keywords are shared by all compiler states */
+	struct compiler_state *container2 = raviX_init_compiler();
+	const struct string_object *s4 = raviX_create_string(container2, s1, (uint32_t)strlen(s1));
+	if (s4 != s2)
+		rc++;
+	const char *s5 = "@integer[]";
+	const struct string_object *s6 = raviX_create_string(container2, s5, (uint32_t)strlen(s5));
+	if (s6->reserved != TOK_TO_INTARRAY - FIRST_RESERVED || strcmp(s6->str, s5) != 0)
+		rc++;
+	const char *s7 = "locals";
+	const struct string_object *s8 = raviX_create_string(container2, s7, (uint32_t)strlen(s7));
+	if (s8->reserved != -1 || s8 != raviX_create_string(container2, s7, (uint32_t)strlen(s7)))
+		rc++;
+	raviX_destroy_compiler(container2);
 	raviX_destroy_compiler(container);
 
+	/* other strings are shared by compiler states that use the same interner */
+	struct string_interner *interner = raviX_create_string_interner();
+	struct compiler_state *container3 = raviX_init_compiler();
+	struct compiler_state *container4 = raviX_init_compiler();
+	raviX_set_string_interner(container3, interner);
+	raviX_set_string_interner(container4, interner);
+	const struct string_object *s9 = raviX_create_string(container3, s7, (uint32_t)strlen(s7));
+	if (s9 != raviX_create_string(container4, s7, (uint32_t)strlen(s7)) || strcmp(s9->str, s7) != 0 || s9->str == s7)
+		rc++;
+	if (raviX_create_string(container4, s1, (uint32_t)strlen(s1)) != s2)
+		rc++;
+	rc += check_many(container3);
+	raviX_destroy_compiler(container4);
+	raviX_destroy_compiler(container3);
+	raviX_destroy_string_interner(interner);
+
+	struct compiler_state *container5 = raviX_init_compiler();
+	rc += check_many(container5);
+	raviX_destroy_compiler(container5);
+
 	return rc;
 }
@@ -0,0 +1,106 @@
+/* checks that the syntax tree left by a failed parse, whose lists are not frozen, can be dumped and
+ * walked, and gives what the statements before the error give when they parse on their own */
+
+#include <ravi_compiler.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { STATEMENTS = 20 }; /* enough for lists of several nodes */
+
+struct counts {
+	int functions;
+	int statements;
+	int expressions;
+};
+
+static void count_expression(void *data, const struct expression *expression)
+{
+	((struct counts *)data)->expressions++;
+}
+
+static void count_statement(void *data, const struct statement *statement)
+{
+	struct counts *counts = (struct counts *)data;
+	counts->statements++;
+	switch (raviX_statement_type(statement)) {
+	case STMT_LOCAL:
+		raviX_local_statement_foreach_expression(raviX_local_statement(statement), data, count_expression);
+		break;
+	case STMT_RETURN:
+		raviX_return_statement_foreach_expression(raviX_return_statement(statement), data, count_expression);
+		break;
+	case STMT_EXPR:
+		raviX_expression_statement_foreach_rhs_expression(raviX_expression_statement(statement), data,
+								  count_expression);
+		break;
+	default:
+		break;
+	}
+}
+
+static void count_function(void *data, const struct function_expression *function)
+{
+	((struct counts *)data)->functions++;
+	raviX_function_foreach_statement(function, data, count_statement);
+	raviX_function_foreach_child(function, data, count_function);
+}
+
+/* Parses code, expecting an error if 'fails' is set, and returns the AST dump and the counts of a walk */
+static char *parse(const char *code, int fails, struct counts *counts)
+{
+	struct compiler_state *container = raviX_init_compiler();
+	if ((raviX_parse(container, code, strlen(code), "input") != 0) != fails) {
+		fprintf(stderr, "parse %s: %s\n", fails ? "worked" : "failed", raviX_get_last_error(container));
+		raviX_destroy_compiler(container);
+		return NULL;
+	}
+	FILE *fp = tmpfile();
+	raviX_output_ast(container, fp);
+	long size = ftell(fp);
+	char *dump = (char *)calloc(1, (size_t)size + 1);
+	rewind(fp);
+	size_t len = fread(dump, 1, (size_t)size, fp);
+	dump[len] = 0;
+	fclose(fp);
+	memset(counts, 0, sizeof *counts);
+	count_function(counts, raviX_ast_get_main_function(container));
+	raviX_destroy_compiler(container);
+	return dump;
+}
+
+int main(int argc, const char *argv[])
+{
+	membuff_t code;
+	raviX_buffer_init(&code, 1024);
+	raviX_buffer_add_string(&code, "local a, b, c, d, e, f, g, h, i, j = 1, 2, 3, 4, 5, 6, 7, 8, 9, 10\n");
+	raviX_buffer_add_string(&code, "local function fn(p, q, r, s, t, u, v, w, x, y)\n");
+	for (int i = 0; i < STATEMENTS; i++)
+		raviX_buffer_add_fstring(&code, "  x%d = p + %d\n", i, i);
+	raviX_buffer_add_string(&code, "  return p, q, r, s, t, u, v, w, x, y\nend\n");
+	for (int i = 0; i < STATEMENTS; i++)
+		raviX_buffer_add_fstring(&code, "y%d = fn(%d)\n", i, i);
+	struct counts expected_counts, counts;
+	char *expected = parse(raviX_buffer_data(&code), 0, &expected_counts);
+	raviX_buffer_add_string(&code, ") = 1\n");
+	char *dump = parse(raviX_buffer_data(&code), 1, &counts);
+	int rc = 0;
+	if (!expected || !dump) {
+		rc = 1;
+	} else if (strcmp(dump, expected) != 0) {
+		fprintf(stderr, "AST dump after a syntax error differs:\n%s\nexpected:\n%s\n", dump, expected);
+		rc = 1;
+	} else if (memcmp(&counts, &expected_counts, sizeof counts) != 0 ||
+		   counts.statements != 2 * STATEMENTS + 3) {
+		fprintf(stderr, "walk after a syntax error found %d functions, %d statements, %d expressions; "
+				"expected %d, %d, %d\n",
+			counts.functions, counts.statements, counts.expressions, expected_counts.functions,
+			expected_counts.statements, expected_counts.expressions);
+		rc = 1;
+	}
+	free(expected);
+	free(dump);
+	raviX_buffer_free(&code);
+	return rc;
+}
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""
+Generates the perfect hash table used by the lexer to classify reserved words,
+operators and the Ravi @type tokens, i.e. all entries of luaX_tokens[] in
+src/lexer.c that precede "<eof>".
+
+The key for a string s is made from s[0], s[1], s[len-1] and len, which is
+multiplied by a constant; the top bits of the product index a table of
+2^BITS slots. The script searches for a multiplier that gives no collisions
+and prints the C code to paste into src/lexer.c.
+
+Usage: python3 tools/gen_keywords.py
+"""
+
+import random
+
+# ORDER TokenType - must match luaX_tokens[] in src/lexer.c
+TOKENS = [
+    "and", "break", "do", "else", "elseif", "end", "false", "for", "function",
+    "goto", "if", "in", "local", "defer", "nil", "not", "or", "repeat",
+    "return", "then", "true", "until", "while", "//", "..", "...", "==",
+    ">=", "<=", "~=", "<<", ">>", "::", "@integer", "@number", "@integer[]",
+    "@number[]", "@table", "@string", "@closure",
+]
+BITS = 6
+
+
+def key(s):
+    return ord(s[0]) | ord(s[1]) << 8 | ord(s[-1]) << 16 | len(s) << 24
+
+
+def slot(s, m):
+    return ((key(s) * m) & 0xFFFFFFFF) >> (32 - BITS)
+
+
+def fnv1a(s):
+    h = 2166136261
+    for c in s.encode():
+        h = ((h ^ c) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+M64 = (1 << 64) - 1
+WYP = [0x2d358dccaa6c78a5, 0x8bb84b93962eacc9, 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47]
+
+
+def wymix(a, b):
+    r = a * b
+    return (r & M64) ^ (r >> 64)
+
+
+def wyhash(s):
+    """wyhash final version 4 with seed 0, truncated to 32 bits as wyhash_data() in src/fnv_hash.c"""
+    p = s.encode()
+    n = len(p)
+    r4 = lambda i: int.from_bytes(p[i:i + 4], "little")
+    r8 = lambda i: int.from_bytes(p[i:i + 8], "little")
+    seed = wymix(WYP[0], WYP[1])
+    if n <= 16:
+        if n >= 4:
+            a = (r4(0) << 32) | r4((n >> 3) << 2)
+            b = (r4(n - 4) << 32) | r4(n - 4 - ((n >> 3) << 2))
+        elif n > 0:
+            a = (p[0] << 16) | (p[n >> 1] << 8) | p[n - 1]
+            b = 0
+        else:
+            a = b = 0
+    else:
+        raise ValueError("keywords are expected to be at most 16 bytes")
+    r = (a ^ WYP[1]) * (b ^ seed)
+    a, b = r & M64, r >> 64
+    return wymix(a ^ WYP[0] ^ n, b ^ WYP[1]) & 0xFFFFFFFF
+
+
+def find_multiplier():
+    rng = random.Random(1)
+    while True:
+        m = rng.getrandbits(32) | 1
+        if len({slot(s, m) for s in TOKENS}) == len(TOKENS):
+            return m
+
+
+def main():
+    m = find_multiplier()
+    slots = [-1] * (1 << BITS)
+    for i, s in enumerate(TOKENS):
+        slots[slot(s, m)] = i
+    print("#define KEYWORD_HASH_BITS %d" % BITS)
+    print("#define KEYWORD_HASH_MULTIPLIER 0x%08xu" % m)
+    print("#define KEYWORD_MIN_LEN %d" % min(len(s) for s in TOKENS))
+    print("#define KEYWORD_MAX_LEN %d" % max(len(s) for s in TOKENS))
+    print("static const int8_t keyword_slots[1 << KEYWORD_HASH_BITS] = {")
+    for i in range(0, len(slots), 16):
+        print("    " + ", ".join("%d" % v for v in slots[i:i + 16]) + ",")
+    print("};")
+    # The text is kept in an array rather than as string literals so that it
+    # does not get merged with identical literals elsewhere in the program
+    print("static const char keyword_text[][KEYWORD_MAX_LEN + 1] = {")
+    for i in range(0, len(TOKENS), 8):
+        print("    " + ", ".join('"%s"' % s for s in TOKENS[i:i + 8]) + ",")
+    print("};")
+    # The hashes must be those computed by raviX_hash_data(), which is chosen at build time
+    print("#if defined(RAVICOMP_FNV_HASH)")
+    print("#define KEYWORD_STRING_HASH(fnv, wyhash) fnv")
+    print("#else")
+    print("#define KEYWORD_STRING_HASH(fnv, wyhash) wyhash")
+    print("#endif")
+    print("static const struct string_object keyword_strings[] = {")
+    for i, s in enumerate(TOKENS):
+        print("    {.len = %d, .reserved = %d, .hash = KEYWORD_STRING_HASH(0x%08xu, 0x%08xu), .str = keyword_text[%d]}," %
+              (len(s), i, fnv1a(s), wyhash(s), i))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
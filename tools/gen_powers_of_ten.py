@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+"""
+Generates the table of 128-bit approximations of powers of ten used by the
+numeral conversion in src/numeral.c.
+
+Entry i holds 10^(i + POW10_MIN_EXP) scaled by a power of two so that its
+most significant bit is bit 127, rounded down, and split into a low and a
+high 64-bit word.
+
+Usage: python3 tools/gen_powers_of_ten.py
+"""
+
+MIN_EXP = -348
+MAX_EXP = 347
+
+
+def approximation(e):
+    if e >= 0:
+        v = 10 ** e
+        n = v.bit_length()
+        return v >> (n - 128) if n > 128 else v << (128 - n)
+    d = 10 ** -e
+    return (1 << (d.bit_length() + 127)) // d
+
+
+def main():
+    print("#define POW10_MIN_EXP (%d)" % MIN_EXP)
+    print("#define POW10_MAX_EXP %d" % MAX_EXP)
+    print("static const uint64_t pow10_table[POW10_MAX_EXP - POW10_MIN_EXP + 1][2] = {")
+    for e in range(MIN_EXP, MAX_EXP + 1):
+        m = approximation(e)
+        assert m >> 127 == 1
+        print("    {0x%016xu, 0x%016xu}, /* 1e%d */" % (m & (2 ** 64 - 1), m >> 64, e))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()